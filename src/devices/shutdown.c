@@ -5,7 +5,14 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/schedtrace.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
@@ -13,6 +20,11 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/falloc.h"
+#include "vm/spt.h"
+#include "vm/swap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -93,6 +105,8 @@ shutdown_power_off (void)
 #ifdef FILESYS
   filesys_done ();
 #endif
+  schedtrace_dump ();
+  profile_dump ();
 
   print_stats ();
 
@@ -130,6 +144,18 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  malloc_print_stats ();
+  kmem_print_stats ();
+#ifdef VM
+  frame_table_print_stats ();
+  spt_print_stats ();
+  swap_print_stats ();
+#endif
+#ifdef LOCKSTAT
+  lockstat_print_stats ();
+#endif
+  workqueue_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -20,10 +21,64 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* -nohz: Stop the periodic tick while the CPU is idle? */
+bool timer_nohz;
+
+/* PIT cycles per timer tick. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot sleep, in ticks, that fits in the PIT's
+   16-bit counter. */
+#define NOHZ_MAX_TICKS (65535 / TICK_CYCLES)
+
+/* Tickless idle state.  While nohz_ticks is nonzero, the PIT is
+   in one-shot mode and interrupts once, at the tick boundary
+   nohz_ticks ticks after the last timer interrupt.  nohz_count
+   is the one-shot count and nohz_partial the PIT cycles since
+   the last timer interrupt that had already gone by when it was
+   armed. */
+static int nohz_ticks;
+static unsigned nohz_count;
+static unsigned nohz_partial;
+static int64_t nohz_skipped;    /* # of ticks without an interrupt. */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Timing wheel for kernel alarms.
+
+   Level 0 has one slot per tick for the next WHEEL_ROOT_SIZE
+   ticks.  Each higher level has WHEEL_LEVEL_SIZE slots, each
+   covering a whole turn of the level below it.  An alarm is
+   hashed into the lowest level that can hold its expiry, and
+   whenever level 0 wraps around, the next slot of each level
+   above is cascaded down one level.  Alarms further out than the
+   top level can hold are parked in its last slot and re-hashed
+   when that slot is cascaded.
+
+   alarm_ticks is the next tick whose level-0 slot has not yet
+   been run. */
+#define WHEEL_ROOT_BITS 8
+#define WHEEL_LEVEL_BITS 6
+#define WHEEL_ROOT_SIZE (1 << WHEEL_ROOT_BITS)
+#define WHEEL_LEVEL_SIZE (1 << WHEEL_LEVEL_BITS)
+#define WHEEL_LEVEL_CNT 3
+#define WHEEL_MAX_DELTA \
+  ((1 << (WHEEL_ROOT_BITS + WHEEL_LEVEL_CNT * WHEEL_LEVEL_BITS)) - 1)
+
+static struct list wheel_root[WHEEL_ROOT_SIZE];
+static struct list wheel_levels[WHEEL_LEVEL_CNT][WHEEL_LEVEL_SIZE];
+static int64_t alarm_ticks;
+
+static void wheel_init (void);
+static void wheel_insert (struct alarm *);
+static bool wheel_cascade (int level);
+static void wheel_run (int64_t now);
+static int64_t wheel_next_event (int64_t limit);
+
+static void timer_tick (void);
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
@@ -35,6 +90,7 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
+  wheel_init ();
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -167,12 +223,295 @@ timer_ndelay (int64_t ns)
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks", timer_ticks ());
+  if (timer_nohz)
+    printf (", %"PRId64" skipped while idle", nohz_skipped);
+  printf ("\n");
+}
+
+/* Called by the idle thread, with interrupts off, just before
+   it halts the CPU.  With -nohz, stops the periodic tick by
+   putting the PIT in one-shot mode so that the next timer
+   interrupt arrives when the next alarm is due, or as late as
+   the PIT allows. */
+void
+timer_idle_enter (void)
+{
+  int64_t next;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_nohz || nohz_ticks != 0)
+    return;
+
+  next = wheel_next_event (ticks + NOHZ_MAX_TICKS);
+  if (next <= ticks + 1)
+    return;
+
+  /* Line the one-shot up with the boundaries the periodic tick
+     would have had, so that no time is lost or gained. */
+  unsigned until_tick = pit_read_counter (0);
+  if (until_tick == 0 || until_tick > TICK_CYCLES)
+    until_tick = TICK_CYCLES;
+  nohz_ticks = next - ticks;
+  nohz_partial = TICK_CYCLES - until_tick;
+  nohz_count = until_tick + (nohz_ticks - 1) * TICK_CYCLES;
+  pit_start_oneshot (0, nohz_count);
+}
+
+/* Called by the interrupt handler, with interrupts off, on each
+   external interrupt.  If the interrupt came in while the
+   periodic tick was stopped by timer_idle_enter(), and it is not
+   the one-shot timer expiring, brings the one-shot in to the next
+   tick boundary.  The timer interrupt there then accounts for the
+   ticks that went by silently, runs any alarms that came due and
+   restarts the periodic tick where it would have been, all from
+   interrupt context as usual. */
+void
+timer_idle_exit (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (nohz_ticks != 0)
+    {
+      unsigned remaining = pit_read_counter (0);
+
+      /* Once the count runs out it wraps around, but then the
+         timer interrupt is already pending. */
+      if (remaining != 0 && remaining <= nohz_count)
+        {
+          unsigned elapsed = nohz_partial + (nohz_count - remaining);
+          int skipped = elapsed / TICK_CYCLES;
+
+          if (skipped + 1 < nohz_ticks)
+            {
+              nohz_ticks = skipped + 1;
+              nohz_partial = elapsed;
+              nohz_count = TICK_CYCLES - elapsed % TICK_CYCLES;
+              pit_start_oneshot (0, nohz_count);
+            }
+        }
+    }
+}
+
+/* Initializes alarm A to call FUNC with AUX when it fires.
+   A is not armed until alarm_set() is called. */
+void
+alarm_init (struct alarm *a, alarm_func *func, void *aux)
+{
+  ASSERT (a != NULL);
+  ASSERT (func != NULL);
+
+  a->expires = 0;
+  a->func = func;
+  a->aux = aux;
+  a->pending = false;
+}
+
+/* Arms alarm A to fire at timer tick EXPIRES, re-arming it if it
+   is already pending.  An EXPIRES that has already passed fires
+   on the next tick.  A fires from the timer interrupt, so its
+   function must not sleep.
+
+   This function may be called from an interrupt handler. */
+void
+alarm_set (struct alarm *a, int64_t expires)
+{
+  enum intr_level old_level;
+
+  ASSERT (a != NULL);
+
+  old_level = intr_disable ();
+  if (a->pending)
+    list_remove (&a->elem);
+  a->expires = expires;
+  a->pending = true;
+  wheel_insert (a);
+  intr_set_level (old_level);
+}
+
+/* Disarms alarm A.  Returns true if A was pending, false if it
+   had already fired or was never armed.
+
+   This function may be called from an interrupt handler. */
+bool
+alarm_cancel (struct alarm *a)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (a != NULL);
+
+  old_level = intr_disable ();
+  was_pending = a->pending;
+  if (was_pending)
+    {
+      list_remove (&a->elem);
+      a->pending = false;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Returns true if alarm A is armed and has not yet fired. */
+bool
+alarm_pending (const struct alarm *a)
+{
+  ASSERT (a != NULL);
+
+  return a->pending;
+}
+
+/* Initializes the alarm timing wheel. */
+static void
+wheel_init (void)
+{
+  int i, j;
+
+  for (i = 0; i < WHEEL_ROOT_SIZE; i++)
+    list_init (&wheel_root[i]);
+  for (i = 0; i < WHEEL_LEVEL_CNT; i++)
+    for (j = 0; j < WHEEL_LEVEL_SIZE; j++)
+      list_init (&wheel_levels[i][j]);
+  alarm_ticks = ticks;
+}
+
+/* Hashes alarm A into the lowest wheel level that can hold its
+   expiry.  Interrupts must be off. */
+static void
+wheel_insert (struct alarm *a)
+{
+  int64_t expires = a->expires;
+  int64_t delta = expires - alarm_ticks;
+  struct list *slot;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (delta < 0)
+    {
+      /* Already due: run it with the next slot. */
+      slot = &wheel_root[alarm_ticks & (WHEEL_ROOT_SIZE - 1)];
+    }
+  else if (delta < WHEEL_ROOT_SIZE)
+    slot = &wheel_root[expires & (WHEEL_ROOT_SIZE - 1)];
+  else
+    {
+      if (delta > WHEEL_MAX_DELTA)
+        {
+          /* Too far out: park in the last slot it can reach. */
+          delta = WHEEL_MAX_DELTA;
+          expires = alarm_ticks + delta;
+        }
+      for (level = 0; level < WHEEL_LEVEL_CNT - 1; level++)
+        if (delta < (1 << (WHEEL_ROOT_BITS + (level + 1) * WHEEL_LEVEL_BITS)))
+          break;
+      slot = &wheel_levels[level][(expires >> (WHEEL_ROOT_BITS
+                                               + level * WHEEL_LEVEL_BITS))
+                                  & (WHEEL_LEVEL_SIZE - 1)];
+    }
+  list_push_back (slot, &a->elem);
+}
+
+/* Moves every alarm in the current slot of wheel LEVEL down to
+   the levels below it.  Returns true if LEVEL has also wrapped
+   around, so that the level above it must be cascaded too. */
+static bool
+wheel_cascade (int level)
+{
+  int idx = (alarm_ticks >> (WHEEL_ROOT_BITS + level * WHEEL_LEVEL_BITS))
+            & (WHEEL_LEVEL_SIZE - 1);
+  struct list *slot = &wheel_levels[level][idx];
+
+  while (!list_empty (slot))
+    wheel_insert (list_entry (list_pop_front (slot), struct alarm, elem));
+  return idx == 0;
+}
+
+/* Fires every alarm that has expired by tick NOW.
+   Runs in the timer interrupt. */
+static void
+wheel_run (int64_t now)
+{
+  while (alarm_ticks <= now)
+    {
+      int idx = alarm_ticks & (WHEEL_ROOT_SIZE - 1);
+      struct list *slot = &wheel_root[idx];
+      struct list expired;
+      int level;
+
+      if (idx == 0)
+        for (level = 0; level < WHEEL_LEVEL_CNT; level++)
+          if (!wheel_cascade (level))
+            break;
+      alarm_ticks++;
+
+      /* Take the slot's alarms off the wheel before running any of
+         them, so that one re-armed for 256 ticks from now, which
+         hashes back into this slot, waits for the next turn. */
+      list_init (&expired);
+      if (!list_empty (slot))
+        list_splice (list_end (&expired), list_begin (slot), list_end (slot));
+      while (!list_empty (&expired))
+        {
+          struct alarm *a = list_entry (list_pop_front (&expired),
+                                        struct alarm, elem);
+          a->pending = false;
+          a->func (a->aux);
+        }
+    }
+}
+
+/* Returns the first tick before LIMIT at which the timing wheel
+   has work to do, that is, either a non-empty level-0 slot or a
+   cascade from the levels above, or LIMIT if there is none.
+   Interrupts must be off. */
+static int64_t
+wheel_next_event (int64_t limit)
+{
+  int64_t t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (t = alarm_ticks; t < limit; t++)
+    {
+      int idx = t & (WHEEL_ROOT_SIZE - 1);
+      if (idx == 0 || !list_empty (&wheel_root[idx]))
+        return t;
+    }
+  return limit;
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
+{
+  profile_sample (args);
+
+  if (nohz_ticks != 0)
+    {
+      /* The one-shot timer expired: restart the periodic tick
+         and account for the ticks that went by silently. */
+      int skipped = nohz_ticks;
+
+      nohz_ticks = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+
+      nohz_skipped += skipped - 1;
+      while (skipped-- > 1)
+        timer_tick ();
+    }
+  timer_tick ();
+
+  /* Lab1 - alarm clock */
+  wheel_run (ticks);
+}
+
+/* Accounts for a single timer tick: advances the tick count and
+   updates the scheduler's per-tick and periodic statistics. */
+static void
+timer_tick (void)
 {
   ticks++;
   thread_tick ();
@@ -188,9 +527,6 @@ timer_interrupt (struct intr_frame *args UNUSED)
     }
     if (ticks % 4 == 0) mlfqs_update_priority_all ();
   }
-
-  /* Lab1 - alarm clock */
-  thread_wakeup (ticks);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
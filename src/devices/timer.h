@@ -1,12 +1,17 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* -nohz: Stop the periodic tick while the CPU is idle. */
+extern bool timer_nohz;
+
 void timer_init (void);
 void timer_calibrate (void);
 
@@ -26,4 +31,28 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless idle. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+/* Kernel alarms: one-shot callbacks run from the timer interrupt
+   once timer_ticks() reaches a given tick.  Armed alarms are
+   kept in a hierarchical timing wheel, so arming, cancelling and
+   expiring an alarm are all O(1) amortized. */
+typedef void alarm_func (void *aux);
+
+struct alarm
+  {
+    int64_t expires;            /* Tick at which to fire. */
+    alarm_func *func;           /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Armed and not yet fired? */
+    struct list_elem elem;      /* Element in a wheel slot. */
+  };
+
+void alarm_init (struct alarm *, alarm_func *, void *aux);
+void alarm_set (struct alarm *, int64_t expires);
+bool alarm_cancel (struct alarm *);
+bool alarm_pending (const struct alarm *);
+
 #endif /* devices/timer.h */
@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -155,6 +156,9 @@ fsutil_extract (char **argv UNUSED)
   free (header);
 }
 
+/* Next sector of the scratch device to append to. */
+static block_sector_t append_sector;
+
 /* Copies file FILE_NAME from the file system to the scratch
    device, in ustar format.
 
@@ -166,8 +170,7 @@ fsutil_extract (char **argv UNUSED)
 void
 fsutil_append (char **argv)
 {
-  static block_sector_t sector = 0;
-
+  block_sector_t sector = append_sector;
   const char *file_name = argv[1];
   void *buffer;
   struct file *src;
@@ -218,6 +221,58 @@ fsutil_append (char **argv)
   block_write (dst, sector + 1, buffer);
 
   /* Finish up. */
+  append_sector = sector;
   file_close (src);
   free (buffer);
 }
+
+/* Appends the SIZE bytes at DATA to the scratch device as a file
+   named FILE_NAME, in ustar format, following anything appended
+   by fsutil_append().  Used to get kernel data, such as traces,
+   out to the host.  Returns true if successful, false if there is
+   no scratch device or it is out of space. */
+bool
+fsutil_append_buffer (const char *file_name, const void *data, size_t size)
+{
+  const uint8_t *p = data;
+  block_sector_t sector = append_sector;
+  struct block *dst;
+  char *header;
+
+  dst = block_get_role (BLOCK_SCRATCH);
+  if (dst == NULL
+      || sector + DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE) + 3 > block_size (dst))
+    return false;
+  header = malloc (BLOCK_SECTOR_SIZE);
+  if (header == NULL)
+    return false;
+  if (!ustar_make_header (file_name, USTAR_REGULAR, size, header))
+    {
+      free (header);
+      return false;
+    }
+  block_write (dst, sector++, header);
+
+  /* Whole sectors straight from DATA, then the tail padded with
+     zeros. */
+  for (; size >= BLOCK_SECTOR_SIZE; size -= BLOCK_SECTOR_SIZE)
+    {
+      block_write (dst, sector++, p);
+      p += BLOCK_SECTOR_SIZE;
+    }
+  if (size > 0)
+    {
+      memset (header, 0, BLOCK_SECTOR_SIZE);
+      memcpy (header, p, size);
+      block_write (dst, sector++, header);
+    }
+
+  /* End-of-archive marker, as in fsutil_append(). */
+  memset (header, 0, BLOCK_SECTOR_SIZE);
+  block_write (dst, sector, header);
+  block_write (dst, sector + 1, header);
+
+  append_sector = sector;
+  free (header);
+  return true;
+}
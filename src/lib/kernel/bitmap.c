@@ -28,8 +28,26 @@ struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    size_t hint[2];     /* No bit below HINT[V] is set to V. */
   };
 
+/* The scan hints.
+
+   HINT[false] and HINT[true] are lower bounds on the index of
+   the first bit set to false and true, respectively.  Setting a
+   bit to V lowers HINT[V] to at most that bit, and
+   bitmap_scan_and_flip() raises HINT[V] to the first bit it
+   found set to V when it started scanning at or below the hint.
+   bitmap_scan() starts scanning at HINT[VALUE] instead of START
+   whenever that is further along, which returns the same bits
+   as starting at START would, without rescanning the bitmap's
+   full prefix every time.
+
+   The hints are not updated atomically with the bits, so callers
+   that scan must serialize against all concurrent modifications
+   of the bitmap, as they already must for bitmap_scan_and_flip()
+   to be meaningful. */
+
 /* Returns the index of the element that contains the bit
    numbered BIT_IDX. */
 static inline size_t
@@ -60,6 +78,42 @@ byte_cnt (size_t bit_cnt)
   return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/* Returns ELEM, the element of B at index IDX, if VALUE is true,
+   or its complement if VALUE is false.  Either way, the bits that
+   are 1 in the result are those set to VALUE in B. */
+static inline elem_type
+elem_value (const struct bitmap *b, size_t idx, bool value)
+{
+  return value ? b->bits[idx] : ~b->bits[idx];
+}
+
+/* Returns the index of the first bit in B at or after START and
+   before END that is set to VALUE, or END if there is none.
+   Examines whole elements at a time. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  size_t idx;
+  elem_type bits;
+
+  ASSERT (end <= b->bit_cnt);
+  if (start >= end)
+    return end;
+
+  /* Ignore the bits in the first element before START. */
+  idx = elem_idx (start);
+  bits = elem_value (b, idx, value) & ~(bit_mask (start) - 1);
+  while (bits == 0)
+    {
+      if ((idx + 1) * ELEM_BITS >= end)
+        return end;
+      bits = elem_value (b, ++idx, value);
+    }
+
+  start = idx * ELEM_BITS + __builtin_ctzl (bits);
+  return start < end ? start : end;
+}
+
 /* Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -85,6 +139,7 @@ bitmap_create (size_t bit_cnt)
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
+          b->hint[false] = b->hint[true] = 0;
           bitmap_set_all (b, false);
           return b;
         }
@@ -105,6 +160,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->hint[false] = b->hint[true] = 0;
   bitmap_set_all (b, false);
   return b;
 }
@@ -163,6 +219,8 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
   asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  if (bit_idx < b->hint[true])
+    b->hint[true] = bit_idx;
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -176,6 +234,8 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  if (bit_idx < b->hint[false])
+    b->hint[false] = bit_idx;
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -191,6 +251,10 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  if (bit_idx < b->hint[false])
+    b->hint[false] = bit_idx;
+  if (bit_idx < b->hint[true])
+    b->hint[true] = bit_idx;
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -213,18 +277,36 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element of B is updated atomically, but not the range as
+   a whole. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t i = start;
+  size_t end = start + cnt;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (i < end)
+    {
+      size_t idx = elem_idx (i);
+      size_t ofs = i % ELEM_BITS;
+      size_t n = end - i < ELEM_BITS - ofs ? end - i : ELEM_BITS - ofs;
+      elem_type mask = (n < ELEM_BITS ? ((elem_type) 1 << n) - 1
+                        : (elem_type) -1) << ofs;
+
+      /* See bitmap_mark() and bitmap_reset(). */
+      if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+      i += n;
+    }
+  if (cnt > 0 && start < b->hint[value])
+    b->hint[value] = start;
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -250,16 +332,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return find_bit (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -290,25 +367,49 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
-   VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
-size_t
-bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
+   VALUE, as bitmap_scan(), and also stores into *FIRST the index
+   of the first bit at or after max(START, B->hint[VALUE]) that is
+   set to VALUE.
+
+   Jumps from one run of bits to the next with find_bit(), so the
+   cost is proportional to the number of elements and runs
+   passed over rather than to the number of bits. */
+static size_t
+scan (const struct bitmap *b, size_t start, size_t cnt, bool value,
+      size_t *first)
 {
+  size_t i;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  *first = i = find_bit (b, start > b->hint[value] ? start : b->hint[value],
+                         b->bit_cnt, value);
+  if (cnt == 0)
+    return start;
+  while (cnt <= b->bit_cnt - i)
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      /* Bits I through END - 1 are set to VALUE. */
+      size_t end = find_bit (b, i, i + cnt, !value);
+      if (end == i + cnt)
+        return i;
+      i = find_bit (b, end, b->bit_cnt, value);
     }
   return BITMAP_ERROR;
 }
 
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B at or after START that are all set to
+   VALUE.
+   If there is no such group, returns BITMAP_ERROR. */
+size_t
+bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
+{
+  size_t first;
+
+  return scan (b, start, cnt, value, &first);
+}
+
 /* Finds the first group of CNT consecutive bits in B at or after
    START that are all set to VALUE, flips them all to !VALUE,
    and returns the index of the first bit in the group.
@@ -319,7 +420,10 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-  size_t idx = bitmap_scan (b, start, cnt, value);
+  size_t first;
+  size_t idx = scan (b, start, cnt, value, &first);
+  if (start <= b->hint[value])
+    b->hint[value] = first;
   if (idx != BITMAP_ERROR) 
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
@@ -347,6 +451,7 @@ bitmap_read (struct bitmap *b, struct file *file)
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
     }
+  b->hint[false] = b->hint[true] = 0;
   return success;
 }
 
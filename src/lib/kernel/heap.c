@@ -0,0 +1,183 @@
+#include "heap.h"
+#include "../debug.h"
+
+static struct heap_elem *meld (struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->size = 0;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = heap->root != NULL ? meld (heap, heap->root, elem) : elem;
+  heap->size++;
+}
+
+/* Removes the top element from HEAP and returns it.
+   Undefined behavior if HEAP is empty before removal. */
+struct heap_elem *
+heap_pop (struct heap *heap)
+{
+  struct heap_elem *top;
+
+  ASSERT (heap != NULL);
+  ASSERT (heap->root != NULL);
+
+  top = heap->root;
+  heap->root = merge_pairs (heap, top->child);
+  heap->size--;
+
+  top->child = NULL;
+  return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem)
+{
+  struct heap_elem *sub;
+
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  if (elem == heap->root)
+    {
+      heap_pop (heap);
+      return;
+    }
+
+  /* Unlink ELEM and its subtree from its parent. */
+  ASSERT (elem->prev != NULL);
+  if (elem->prev->child == elem)
+    elem->prev->child = elem->next;
+  else
+    elem->prev->next = elem->next;
+  if (elem->next != NULL)
+    elem->next->prev = elem->prev;
+
+  /* Put ELEM's children back. */
+  sub = merge_pairs (heap, elem->child);
+  if (sub != NULL)
+    heap->root = meld (heap, heap->root, sub);
+  heap->size--;
+
+  elem->child = elem->next = elem->prev = NULL;
+}
+
+/* Restores the heap order of HEAP after the key of ELEM, which
+   must be in HEAP, has changed. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem)
+{
+  heap_remove (heap, elem);
+  heap_push (heap, elem);
+}
+
+/* Returns the top element of HEAP, or a null pointer if HEAP is
+   empty. */
+struct heap_elem *
+heap_top (const struct heap *heap)
+{
+  ASSERT (heap != NULL);
+
+  return heap->root;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (const struct heap *heap)
+{
+  ASSERT (heap != NULL);
+
+  return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap)
+{
+  ASSERT (heap != NULL);
+
+  return heap->root == NULL;
+}
+
+/* Melds the trees rooted at A and B, neither of which may have
+   siblings, and returns the root of the result. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  if (heap->less (a, b, heap->aux))
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  /* Make B the leftmost child of A. */
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  b->prev = a;
+  a->child = b;
+
+  return a;
+}
+
+/* Melds the list of sibling trees starting at FIRST into a
+   single tree and returns its root, or a null pointer if FIRST
+   is null.  Siblings are melded in pairs from left to right,
+   then the pairs are melded from right to left, which is what
+   gives the pairing heap its amortized bounds. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* Left to right, pushing each melded pair onto PAIRS. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        {
+          b->next = b->prev = NULL;
+          a = meld (heap, a, b);
+        }
+      a->next = pairs;
+      pairs = a;
+    }
+
+  /* Right to left. */
+  while (pairs != NULL)
+    {
+      struct heap_elem *next = pairs->next;
+
+      pairs->next = NULL;
+      root = root != NULL ? meld (heap, pairs, root) : pairs;
+      pairs = next;
+    }
+
+  return root;
+}
@@ -0,0 +1,72 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue.
+
+   This is a pairing heap: a heap-ordered tree in which each node
+   keeps its children in a linked list.  Pushing an element and
+   melding are O(1); popping the top element and removing or
+   re-keying an arbitrary element take O(lg n) amortized time.
+
+   Like the linked list and hash table, the heap does not use
+   dynamic allocation.  Each structure that can potentially be in
+   a heap must embed a struct heap_elem member, and the
+   heap_entry macro converts from a struct heap_elem back to the
+   structure that contains it.  Refer to lib/kernel/list.h for a
+   detailed explanation of the technique.
+
+   The heap is ordered by a caller-supplied "less" function.  The
+   top of the heap is a greatest element, that is, one that is
+   not less than any other.  If the key of an element changes
+   while it is in the heap, heap_update() must be called to
+   restore the heap order. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *child;    /* Leftmost child. */
+    struct heap_elem *next;     /* Next sibling. */
+    struct heap_elem *prev;     /* Previous sibling, or parent if
+                                   leftmost child. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->next     \
+                     - offsetof (STRUCT, MEMBER.next)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Top element, or null if empty. */
+    size_t size;                /* Number of elements. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+struct heap_elem *heap_top (const struct heap *);
+size_t heap_size (const struct heap *);
+bool heap_empty (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
@@ -1,5 +1,38 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The functions that scan or copy whole blocks work a 32-bit word
+   at a time where they can.  memcpy() and memset() use the x86
+   string instructions, with a byte-wise prologue that aligns the
+   destination so that the word moves do not straddle words.  The
+   others load words with ordinary loads: x86 allows unaligned
+   loads, and an aligned load never crosses into another page, so
+   reading the rest of the word that holds a string's null
+   terminator cannot fault.  All of them rely on the direction
+   flag being clear, as the i386 ABI and the interrupt entry code
+   guarantee. */
+
+/* A word that may alias memory of any type, at any alignment. */
+typedef uint32_t word_t __attribute__ ((may_alias, aligned (1)));
+
+/* Blocks shorter than this many bytes are copied or set a byte at
+   a time, since aligning them costs more than it saves. */
+#define WORD_MIN 16
+
+/* Returns a word each of whose bytes is C. */
+static inline uint32_t
+byte_word (unsigned char c) 
+{
+  return c * 0x01010101u;
+}
+
+/* Returns nonzero if any byte in W is zero. */
+static inline uint32_t
+has_zero_byte (uint32_t w) 
+{
+  return (w - 0x01010101u) & ~w & 0x80808080u;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,8 +45,20 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
+  if (size >= WORD_MIN) 
+    {
+      /* Copy up to a word boundary in DST, then whole words. */
+      size_t head = -(uintptr_t) dst % sizeof (word_t);
+      size_t words = (size - head) / sizeof (word_t);
+
+      size -= head + words * sizeof (word_t);
+      asm volatile ("rep movsb"
+                    : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+    }
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (size) : : "memory");
 
   return dst_;
 }
@@ -58,6 +103,11 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip past equal words, then find the differing byte. */
+  for (; size >= sizeof (word_t); a += sizeof (word_t), b += sizeof (word_t),
+         size -= sizeof (word_t))
+    if (*(const word_t *) a != *(const word_t *) b)
+      break;
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -95,9 +145,19 @@ memchr (const void *block_, int ch_, size_t size)
 {
   const unsigned char *block = block_;
   unsigned char ch = ch_;
+  uint32_t pattern = byte_word (ch);
 
   ASSERT (block != NULL || size == 0);
 
+  /* Check bytes up to a word boundary, then skip whole words
+     without CH, then find CH within the word that has it. */
+  for (; size > 0 && (uintptr_t) block % sizeof (word_t) != 0; size--, block++)
+    if (*block == ch)
+      return (void *) block;
+  for (; size >= sizeof (word_t); size -= sizeof (word_t),
+         block += sizeof (word_t))
+    if (has_zero_byte (*(const word_t *) block ^ pattern))
+      break;
   for (; size-- > 0; block++)
     if (*block == ch)
       return (void *) block;
@@ -281,9 +341,21 @@ memset (void *dst_, int value, size_t size)
   unsigned char *dst = dst_;
 
   ASSERT (dst != NULL || size == 0);
-  
-  while (size-- > 0)
-    *dst++ = value;
+
+  if (size >= WORD_MIN) 
+    {
+      /* Set up to a word boundary, then whole words. */
+      size_t head = -(uintptr_t) dst % sizeof (word_t);
+      size_t words = (size - head) / sizeof (word_t);
+
+      size -= head + words * sizeof (word_t);
+      asm volatile ("rep stosb"
+                    : "+D" (dst), "+c" (head) : "a" (value) : "memory");
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words) : "a" (byte_word (value))
+                    : "memory");
+    }
+  asm volatile ("rep stosb" : "+D" (dst), "+c" (size) : "a" (value) : "memory");
 
   return dst_;
 }
@@ -296,8 +368,15 @@ strlen (const char *string)
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
-    continue;
+  /* Check bytes up to a word boundary, then skip whole words
+     without a null byte, then find it within the word. */
+  for (p = string; (uintptr_t) p % sizeof (word_t) != 0; p++)
+    if (*p == '\0')
+      return p - string;
+  while (!has_zero_byte (*(const word_t *) p))
+    p += sizeof (word_t);
+  while (*p != '\0')
+    p++;
   return p - string;
 }
 
@@ -0,0 +1,137 @@
+/* Benchmark and test program for scanning in lib/kernel/bitmap.c.
+
+   Compares bitmap_scan() against the bit-at-a-time scan it
+   replaced, on bitmaps filled to various levels at random,
+   checking that both find the same groups and reporting the
+   average number of CPU cycles each takes.  Then checks that
+   bitmap_scan_and_flip() still allocates first-fit as a bitmap
+   is filled up and emptied again.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of bits in the bitmaps we test, about as many as there
+   are pages in a 32 MB pool. */
+#define BIT_CNT 8192
+
+/* Number of scans timed for each fill level and group size. */
+#define ITER_CNT 64
+
+static const int fill_pcts[] = {0, 50, 90, 99};
+static const size_t scan_cnts[] = {1, 4, 16};
+
+static size_t old_scan (const struct bitmap *, size_t start, size_t cnt,
+                        bool);
+static uint64_t cycles (void);
+
+/* Test bitmap scanning. */
+void
+test (void)
+{
+  struct bitmap *b;
+  size_t i, j;
+
+  b = bitmap_create (BIT_CNT);
+  ASSERT (b != NULL);
+
+  printf ("cycles per scan of %d bits, old/new:\n", BIT_CNT);
+  for (i = 0; i < sizeof fill_pcts / sizeof *fill_pcts; i++)
+    {
+      size_t idx;
+
+      /* Fill FILL_PCTS[i] percent of the bits at random. */
+      random_init (i);
+      bitmap_set_all (b, false);
+      for (idx = 0; idx < BIT_CNT; idx++)
+        if (random_ulong () % 100 < (unsigned) fill_pcts[i])
+          bitmap_mark (b, idx);
+
+      printf ("%3d%% full:", fill_pcts[i]);
+      for (j = 0; j < sizeof scan_cnts / sizeof *scan_cnts; j++)
+        {
+          uint64_t old_cycles = 0, new_cycles = 0, start;
+          int k;
+
+          for (k = 0; k < ITER_CNT; k++)
+            {
+              size_t first = random_ulong () % BIT_CNT;
+              size_t old_idx, new_idx;
+
+              start = cycles ();
+              old_idx = old_scan (b, first, scan_cnts[j], false);
+              old_cycles += cycles () - start;
+
+              start = cycles ();
+              new_idx = bitmap_scan (b, first, scan_cnts[j], false);
+              new_cycles += cycles () - start;
+
+              ASSERT (old_idx == new_idx);
+            }
+          printf (" %zu bits %"PRIu64"/%"PRIu64, scan_cnts[j],
+                  old_cycles / ITER_CNT, new_cycles / ITER_CNT);
+        }
+      printf ("\n");
+    }
+
+  /* Allocate every bit in groups of 3, then free every other
+     group and allocate the holes again, which must come back in
+     first-fit order. */
+  bitmap_set_all (b, false);
+  for (i = 0; i + 3 <= BIT_CNT; i += 3)
+    ASSERT (bitmap_scan_and_flip (b, 0, 3, false) == i);
+  ASSERT (bitmap_scan_and_flip (b, 0, 3, false) == BITMAP_ERROR);
+  for (i = 0; i + 3 <= BIT_CNT; i += 6)
+    bitmap_set_multiple (b, i, 3, false);
+  for (i = 0; i + 3 <= BIT_CNT; i += 6)
+    ASSERT (bitmap_scan_and_flip (b, 0, 3, false) == i);
+  ASSERT (bitmap_scan_and_flip (b, 0, 1, false) == BIT_CNT / 3 * 3);
+
+  bitmap_destroy (b);
+  printf ("done\n");
+}
+
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B at or after START that are all set to
+   VALUE, one bit at a time, as bitmap_scan() used to.
+   If there is no such group, returns BITMAP_ERROR. */
+static size_t
+old_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t bit_cnt = bitmap_size (b);
+
+  if (cnt <= bit_cnt)
+    {
+      size_t last = bit_cnt - cnt;
+      size_t i;
+      for (i = start; i <= last; i++)
+        {
+          size_t j;
+
+          for (j = 0; j < cnt; j++)
+            if (bitmap_test (b, i + j) != value)
+              break;
+          if (j == cnt)
+            return i;
+        }
+    }
+  return BITMAP_ERROR;
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+cycles (void)
+{
+  uint64_t tsc;
+
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
@@ -0,0 +1,188 @@
+/* Test and benchmark program for the block functions in
+   lib/string.c.
+
+   Checks memcpy(), memset(), memcmp(), memchr() and strlen()
+   against simple byte-at-a-time versions for every combination of
+   source and destination alignment and for lengths on both sides
+   of the point where they switch to word-wide loops, making sure
+   nothing outside the block is touched.  Then reports how many
+   bytes per 100 CPU cycles each of them and its byte-at-a-time
+   counterpart processes on page-size blocks.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+
+/* Largest block length to check, and size of the test buffers. */
+#define MAX_LEN 80
+#define BUF_SIZE (MAX_LEN + 16)
+
+/* Block length for the throughput measurements. */
+#define BENCH_LEN 4096
+
+/* Number of times each function is timed. */
+#define ITER_CNT 16
+
+static unsigned char buf_a[BUF_SIZE], buf_b[BUF_SIZE], buf_c[BUF_SIZE];
+static unsigned char big_a[BENCH_LEN + 1], big_b[BENCH_LEN + 1];
+
+static void test_block (size_t dst_ofs, size_t src_ofs, size_t len);
+static void fill (unsigned char *, size_t);
+static void bench (void);
+static uint64_t cycles (void);
+
+/* Test and time the string functions. */
+void
+test (void)
+{
+  size_t dst_ofs, src_ofs, len;
+
+  printf ("testing block functions:");
+  random_init (0);
+  for (len = 0; len <= MAX_LEN; len++)
+    {
+      for (dst_ofs = 0; dst_ofs < 8; dst_ofs++)
+        for (src_ofs = 0; src_ofs < 8; src_ofs++)
+          test_block (dst_ofs, src_ofs, len);
+      if (len % 10 == 0)
+        printf (" %zu", len);
+    }
+  printf (" done\n");
+
+  bench ();
+  printf ("done\n");
+}
+
+/* Checks the block functions on blocks of LEN bytes at offsets
+   DST_OFS and SRC_OFS in the test buffers. */
+static void
+test_block (size_t dst_ofs, size_t src_ofs, size_t len)
+{
+  unsigned char *dst = buf_a + dst_ofs;
+  unsigned char *src = buf_c + src_ofs;
+  unsigned char value = random_ulong ();
+  size_t i;
+
+  /* memcpy(), checked against a byte loop into BUF_B. */
+  fill (buf_a, BUF_SIZE);
+  fill (buf_c, BUF_SIZE);
+  for (i = 0; i < BUF_SIZE; i++)
+    buf_b[i] = buf_a[i];
+  for (i = 0; i < len; i++)
+    buf_b[dst_ofs + i] = src[i];
+  ASSERT (memcpy (dst, src, len) == dst);
+  for (i = 0; i < BUF_SIZE; i++)
+    ASSERT (buf_a[i] == buf_b[i]);
+
+  /* memset(). */
+  for (i = 0; i < len; i++)
+    buf_b[dst_ofs + i] = value;
+  ASSERT (memset (dst, value, len) == dst);
+  for (i = 0; i < BUF_SIZE; i++)
+    ASSERT (buf_a[i] == buf_b[i]);
+
+  /* memcmp(), on equal blocks and then with one byte changed. */
+  ASSERT (memcmp (buf_a + dst_ofs, buf_b + dst_ofs, len) == 0);
+  if (len > 0)
+    {
+      size_t ofs = dst_ofs + random_ulong () % len;
+
+      buf_b[ofs]++;
+      ASSERT (memcmp (buf_a + dst_ofs, buf_b + dst_ofs, len)
+              == (buf_a[ofs] > buf_b[ofs] ? 1 : -1));
+      ASSERT (memcmp (buf_b + dst_ofs, buf_a + dst_ofs, len)
+              == (buf_b[ofs] > buf_a[ofs] ? 1 : -1));
+    }
+
+  /* memchr() and strlen(), on a block of nonzero bytes. */
+  for (i = 0; i < BUF_SIZE; i++)
+    buf_c[i] = random_ulong () % 4 + 1;
+  value = random_ulong () % 6;
+  for (i = 0; i < len; i++)
+    if (src[i] == value)
+      break;
+  ASSERT (memchr (src, value, len) == (i < len ? src + i : NULL));
+  src[len] = '\0';
+  ASSERT (strlen ((char *) src) == len);
+}
+
+/* Fills the SIZE bytes at BUF with random bytes. */
+static void
+fill (unsigned char *buf, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = random_ulong ();
+}
+
+/* Prints the throughput of the block functions next to that of
+   byte-at-a-time loops doing the same work. */
+static void
+bench (void)
+{
+  uint64_t fast, slow, start;
+  volatile size_t sink = 0;
+  int iter;
+  size_t i;
+
+#define TIME(VAR, STMT)                         \
+  do {                                          \
+    VAR = 0;                                    \
+    for (iter = 0; iter < ITER_CNT; iter++)     \
+      {                                         \
+        start = cycles ();                      \
+        STMT;                                   \
+        VAR += cycles () - start;               \
+      }                                         \
+  } while (0)
+#define REPORT(NAME)                                                    \
+  printf ("%-8s %6"PRIu64" bytes/100 cycles, %6"PRIu64" byte-wise\n",  \
+          NAME, (uint64_t) BENCH_LEN * ITER_CNT * 100 / (fast + 1),     \
+          (uint64_t) BENCH_LEN * ITER_CNT * 100 / (slow + 1))
+
+  TIME (fast, memcpy (big_a, big_b, BENCH_LEN));
+  TIME (slow, for (i = 0; i < BENCH_LEN; i++) big_a[i] = big_b[i]);
+  REPORT ("memcpy");
+
+  TIME (fast, memset (big_a, 1, BENCH_LEN));
+  TIME (slow, for (i = 0; i < BENCH_LEN; i++) big_a[i] = 1);
+  REPORT ("memset");
+
+  memset (big_b, 1, BENCH_LEN);
+  TIME (fast, sink += memcmp (big_a, big_b, BENCH_LEN));
+  TIME (slow, for (i = 0; i < BENCH_LEN && big_a[i] == big_b[i]; i++)
+                continue; sink += i);
+  REPORT ("memcmp");
+
+  TIME (fast, sink += memchr (big_a, 0, BENCH_LEN) != NULL);
+  TIME (slow, for (i = 0; i < BENCH_LEN && big_a[i] != 0; i++) continue;
+              sink += i);
+  REPORT ("memchr");
+
+  big_a[BENCH_LEN] = '\0';
+  TIME (fast, sink += strlen ((char *) big_a));
+  TIME (slow, for (i = 0; big_a[i] != '\0'; i++) continue; sink += i);
+  REPORT ("strlen");
+
+#undef TIME
+#undef REPORT
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+cycles (void)
+{
+  uint64_t tsc;
+
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
@@ -0,0 +1,112 @@
+/* Allocates OBJ_CNT objects from an object cache, enough to fill
+   several slabs, and checks that they are distinct, do not
+   overlap, and come constructed.  Each object is then modified,
+   restored to its constructed state and freed, in an interleaved
+   order, and the objects are allocated again.  The constructor
+   must have run exactly once per object: freed objects keep
+   their constructed state, so reallocating them constructs
+   nothing new. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 200
+
+/* An object whose size malloc() would round up a long way. */
+struct object
+  {
+    int magic;
+    char data[66];
+  };
+
+#define OBJECT_MAGIC 0x1234abcd
+
+static struct object *objects[OBJ_CNT];
+static int ctor_cnt;
+
+static void object_ctor (void *);
+static void check_objects (void);
+
+void
+test_kmem_cache (void)
+{
+  struct kmem_cache *cache;
+  int constructed;
+  int i;
+
+  cache = kmem_cache_create ("test", sizeof (struct object), object_ctor);
+  if (cache == NULL)
+    fail ("kmem_cache_create failed");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objects[i] = kmem_cache_alloc (cache);
+      if (objects[i] == NULL)
+        fail ("kmem_cache_alloc failed");
+    }
+  check_objects ();
+  constructed = ctor_cnt;
+  msg ("%d objects allocated.", OBJ_CNT);
+
+  /* Free every other object, then the rest. */
+  for (i = 0; i < 2 * OBJ_CNT; i += 2)
+    {
+      struct object *o = objects[i % OBJ_CNT + i / OBJ_CNT];
+      memset (o->data, i, sizeof o->data);
+      memset (o->data, 0, sizeof o->data);
+      kmem_cache_free (cache, o);
+    }
+  msg ("%d objects freed.", OBJ_CNT);
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objects[i] = kmem_cache_alloc (cache);
+      if (objects[i] == NULL)
+        fail ("kmem_cache_alloc failed");
+    }
+  check_objects ();
+  if (ctor_cnt != constructed)
+    fail ("constructor ran %d more times on reallocation",
+          ctor_cnt - constructed);
+  msg ("%d objects reallocated.", OBJ_CNT);
+
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objects[i]);
+  kmem_cache_destroy (cache);
+  pass ();
+}
+
+static void
+object_ctor (void *o_)
+{
+  struct object *o = o_;
+
+  o->magic = OBJECT_MAGIC;
+  memset (o->data, 0, sizeof o->data);
+  ctor_cnt++;
+}
+
+/* Checks that the objects in OBJECTS are constructed and that
+   no two of them overlap. */
+static void
+check_objects (void)
+{
+  int i, j;
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      struct object *o = objects[i];
+
+      if (o->magic != OBJECT_MAGIC)
+        fail ("object %d is not constructed", i);
+      for (j = 0; j < (int) sizeof o->data; j++)
+        if (o->data[j] != 0)
+          fail ("object %d lost its constructed state", i);
+      for (j = 0; j < i; j++)
+        if ((char *) objects[j] < (char *) o + sizeof *o
+            && (char *) o < (char *) objects[j] + sizeof *o)
+          fail ("objects %d and %d overlap", j, i);
+    }
+}
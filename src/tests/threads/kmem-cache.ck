@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(kmem-cache) begin
+(kmem-cache) 200 objects allocated.
+(kmem-cache) 200 objects freed.
+(kmem-cache) 200 objects reallocated.
+(kmem-cache) end
+EOF
+pass;
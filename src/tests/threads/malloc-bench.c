@@ -0,0 +1,79 @@
+/* Measures the cost of malloc() and free() for a few block
+   sizes, in average CPU cycles per malloc()/free() pair.  Each
+   size is timed twice: freeing each block right after allocating
+   it, which the current CPU's magazines should serve without
+   taking any lock, and allocating BATCH_CNT blocks before freeing
+   them all, which runs through several magazines and so also
+   exercises their exchange with the depot.  The blocks of a
+   batch must be distinct and must not overlap. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+
+#define ITER_CNT 1024
+#define BATCH_CNT 100
+
+static const size_t sizes[] = {16, 64, 256, 1024};
+
+static uint8_t *blocks[BATCH_CNT];
+
+void
+test_malloc_bench (void)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      size_t size = sizes[i];
+      uint64_t pair = 0, batch = 0, start;
+      int j, k;
+
+      /* Warm up, so that neither loop pays for new arenas. */
+      for (j = 0; j < BATCH_CNT; j++)
+        blocks[j] = malloc (size);
+      for (j = 0; j < BATCH_CNT; j++)
+        free (blocks[j]);
+
+      start = bench_cycles ();
+      for (j = 0; j < ITER_CNT; j++)
+        free (malloc (size));
+      pair = bench_cycles () - start;
+
+      for (j = 0; j < ITER_CNT / BATCH_CNT; j++)
+        {
+          start = bench_cycles ();
+          for (k = 0; k < BATCH_CNT; k++)
+            {
+              blocks[k] = malloc (size);
+              if (blocks[k] == NULL)
+                fail ("malloc of %zu bytes failed", size);
+            }
+          batch += bench_cycles () - start;
+
+          for (k = 0; k < BATCH_CNT; k++)
+            {
+              int l;
+
+              memset (blocks[k], k, size);
+              for (l = 0; l < k; l++)
+                if (blocks[l] < blocks[k] + size
+                    && blocks[k] < blocks[l] + size)
+                  fail ("%zu-byte blocks %d and %d overlap", size, l, k);
+            }
+
+          start = bench_cycles ();
+          for (k = 0; k < BATCH_CNT; k++)
+            free (blocks[k]);
+          batch += bench_cycles () - start;
+        }
+
+      msg ("%zu bytes: %"PRIu64" cycles paired, %"PRIu64" cycles batched.",
+           size, pair / ITER_CNT,
+           batch / (ITER_CNT / BATCH_CNT * BATCH_CNT));
+    }
+
+  pass ();
+}
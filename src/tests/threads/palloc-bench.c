@@ -0,0 +1,149 @@
+/* Measures the latency of page allocation in a nearly full pool.
+   The user pool is filled with a mix of single pages and 4-page
+   blocks, as when malloc()'s big blocks interleave with single
+   pages, and then about a tenth of them are freed at random,
+   leaving the pool about 90% occupied.  The average number of
+   CPU cycles per allocation of 1, 2, 4 and 8 pages is then
+   reported, both for the page allocator and for a first-fit scan
+   of a bitmap of the same occupancy, which is how the page
+   allocator used to work.
+
+   The page allocator is a buddy system, so its cost does not
+   depend on how full the pool is, while the first-fit scan has
+   to walk past every used page in front of the first hole large
+   enough.  Once everything is freed again, the buddies must have
+   merged back into blocks as large as the pool allows. */
+
+#include <bitmap.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define ITER_CNT 256
+
+static const size_t page_cnts[] = {1, 2, 4, 8};
+
+/* An allocated block, kept in its own first page. */
+struct block
+  {
+    struct block *next;
+    size_t page_cnt;
+  };
+
+static void mark (struct bitmap *, uint8_t *base, struct block *);
+
+void
+test_palloc_bench (void)
+{
+  struct block *blocks = NULL, **bp, *b;
+  struct bitmap *used_map;
+  uint8_t *lo = NULL, *hi = NULL;
+  size_t total = 0, used = 0, i;
+  int order;
+
+  /* Fill the user pool. */
+  random_init (0);
+  for (i = 0; ; i++)
+    {
+      size_t page_cnt = i % 4 == 3 ? 4 : 1;
+      b = palloc_get_multiple (PAL_USER, page_cnt);
+      if (b == NULL && page_cnt > 1)
+        b = palloc_get_multiple (PAL_USER, page_cnt = 1);
+      if (b == NULL)
+        break;
+      b->next = blocks;
+      b->page_cnt = page_cnt;
+      blocks = b;
+      total += page_cnt;
+      if (lo == NULL || (uint8_t *) b < lo)
+        lo = (uint8_t *) b;
+      if ((uint8_t *) b + page_cnt * PGSIZE > hi)
+        hi = (uint8_t *) b + page_cnt * PGSIZE;
+    }
+  if (total == 0)
+    fail ("no pages in user pool");
+
+  /* Free about a tenth of the blocks and mark the rest in a
+     bitmap, checking that none of them overlap. */
+  used_map = bitmap_create ((hi - lo) / PGSIZE);
+  if (used_map == NULL)
+    fail ("out of memory");
+  for (bp = &blocks; *bp != NULL; )
+    {
+      b = *bp;
+      if (random_ulong () % 10 == 0)
+        {
+          *bp = b->next;
+          palloc_free_multiple (b, b->page_cnt);
+        }
+      else
+        {
+          mark (used_map, lo, b);
+          used += b->page_cnt;
+          bp = &b->next;
+        }
+    }
+  msg ("%zu of %zu user pages in use.", used, total);
+
+  for (i = 0; i < sizeof page_cnts / sizeof *page_cnts; i++)
+    {
+      size_t page_cnt = page_cnts[i];
+      uint64_t first_fit = 0, buddy = 0, start;
+      int j;
+
+      for (j = 0; j < ITER_CNT; j++)
+        {
+          size_t idx;
+          void *pages;
+
+          start = bench_cycles ();
+          idx = bitmap_scan_and_flip (used_map, 0, page_cnt, false);
+          first_fit += bench_cycles () - start;
+          if (idx != BITMAP_ERROR)
+            bitmap_set_multiple (used_map, idx, page_cnt, false);
+
+          start = bench_cycles ();
+          pages = palloc_get_multiple (PAL_USER, page_cnt);
+          buddy += bench_cycles () - start;
+          if (pages != NULL)
+            palloc_free_multiple (pages, page_cnt);
+        }
+
+      msg ("%zu pages: %"PRIu64" cycles first-fit, %"PRIu64" cycles buddy.",
+           page_cnt, first_fit / ITER_CNT, buddy / ITER_CNT);
+    }
+
+  /* Free everything.  The whole pool must then be free again,
+     with its pages merged into the largest block that fits. */
+  while (blocks != NULL)
+    {
+      b = blocks;
+      blocks = b->next;
+      palloc_free_multiple (b, b->page_cnt);
+    }
+  bitmap_destroy (used_map);
+  for (order = 0; ((size_t) 2 << order) <= total; order++)
+    continue;
+  b = palloc_get_multiple (PAL_USER, (size_t) 1 << order);
+  if (b == NULL)
+    fail ("no free block of %zu pages after freeing %zu pages",
+          (size_t) 1 << order, total);
+  palloc_free_multiple (b, (size_t) 1 << order);
+
+  pass ();
+}
+
+/* Marks the pages of block B in USED_MAP, whose bit 0 is the
+   page at BASE, failing if any of them already were. */
+static void
+mark (struct bitmap *used_map, uint8_t *base, struct block *b)
+{
+  size_t idx = ((uint8_t *) b - base) / PGSIZE;
+
+  if (!bitmap_none (used_map, idx, b->page_cnt))
+    fail ("pages at %p allocated twice", b);
+  bitmap_set_multiple (used_map, idx, b->page_cnt, true);
+}
@@ -0,0 +1,99 @@
+/* The main thread lowers its priority to PRI_MIN, acquires lock 0
+   of CHAIN_LEN + 1 locks, and creates CHAIN_LEN threads at
+   PRI_MIN + 1.  Thread i acquires lock i, then waits for lock
+   i - 1, so the threads form a chain of CHAIN_LEN locks ending
+   at the main thread.  A last thread at PRI_MAX then waits for
+   lock CHAIN_LEN, and its priority must be donated all the way
+   down the chain.  The number of CPU cycles that donation takes
+   is reported.
+
+   When the main thread releases lock 0, the chain unwinds one
+   thread at a time.  Each chain thread must run at PRI_MAX while
+   it holds the lock the next one is waiting for, and drop back
+   to PRI_MIN + 1 once it has released both of its locks. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define CHAIN_LEN 100
+
+static struct lock locks[CHAIN_LEN + 1];
+static uint64_t start;
+static int wrong_cnt;
+
+static thread_func chain_thread_func;
+static thread_func top_thread_func;
+
+void
+test_priority_donate_deep (void) 
+{
+  uint64_t cycles;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+
+  for (i = 0; i <= CHAIN_LEN; i++)
+    lock_init (&locks[i]);
+  lock_acquire (&locks[0]);
+
+  for (i = 1; i <= CHAIN_LEN; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "chain %d", i);
+      thread_create (name, PRI_MIN + 1, chain_thread_func, &locks[i]);
+
+      /* Let it run until it blocks on lock I - 1. */
+      thread_yield ();
+    }
+  if (thread_get_priority () != PRI_MIN + 1)
+    fail ("main should have priority %d.  Actual priority: %d.",
+          PRI_MIN + 1, thread_get_priority ());
+
+  /* The top thread preempts us, sets START and blocks. */
+  thread_create ("top", PRI_MAX, top_thread_func, NULL);
+  cycles = bench_cycles () - start;
+  if (thread_get_priority () != PRI_MAX)
+    fail ("main should have priority %d.  Actual priority: %d.",
+          PRI_MAX, thread_get_priority ());
+  msg ("Donation through %d locks: %"PRIu64" cycles.", CHAIN_LEN, cycles);
+
+  lock_release (&locks[0]);
+  if (thread_get_priority () != PRI_MIN)
+    fail ("main should have priority %d.  Actual priority: %d.",
+          PRI_MIN, thread_get_priority ());
+  if (wrong_cnt != 0)
+    fail ("%d chain threads ran at the wrong priority.", wrong_cnt);
+
+  pass ();
+}
+
+static void
+chain_thread_func (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  lock_acquire (lock - 1);
+  if (thread_get_priority () != PRI_MAX)
+    wrong_cnt++;
+
+  lock_release (lock - 1);
+  lock_release (lock);
+  if (thread_get_priority () != PRI_MIN + 1)
+    wrong_cnt++;
+}
+
+static void
+top_thread_func (void *aux UNUSED) 
+{
+  start = bench_cycles ();
+  lock_acquire (&locks[CHAIN_LEN]);
+  lock_release (&locks[CHAIN_LEN]);
+}
@@ -0,0 +1,95 @@
+/* Measures the cost of waking a thread from a semaphore as the
+   number of waiters grows.  For each size, WAITER_CNT threads at
+   priorities spread below ours block on one semaphore, and the
+   average number of CPU cycles per sema_up() is reported while
+   they are woken one by one, up to 500 waiters.
+
+   The waiters are kept in a heap keyed on their priority, so
+   each wakeup is logarithmic in the number of waiters instead of
+   sorting them all, and the reported cost should grow only
+   slowly from the smallest to the largest size.  The waiters
+   must still be woken highest priority first. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WAITER_MAX 500
+
+static const int waiter_cnts[] = {1, 10, 100, WAITER_MAX};
+
+static struct semaphore sema;
+static struct semaphore done;
+static int wake_order[WAITER_MAX];
+static int wake_cnt;
+
+static thread_func waiter;
+
+void
+test_priority_sema_bench (void) 
+{
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&sema, 0);
+  sema_init (&done, 0);
+  for (i = 0; i < sizeof waiter_cnts / sizeof *waiter_cnts; i++) 
+    {
+      int waiter_cnt = waiter_cnts[i];
+      uint64_t start, cycles;
+      int j;
+
+      for (j = 0; j < waiter_cnt; j++) 
+        {
+          int priority = PRI_MIN + 1 + j * 7 % (PRI_DEFAULT - PRI_MIN - 1);
+          char name[16];
+          snprintf (name, sizeof name, "%d", j);
+          thread_create (name, priority, waiter, NULL);
+        }
+
+      /* Let every waiter run and block on SEMA. */
+      thread_set_priority (PRI_MIN);
+      thread_set_priority (PRI_DEFAULT);
+
+      /* The waiters are all below us, so none of them runs until
+         we block again. */
+      wake_cnt = 0;
+      start = bench_cycles ();
+      for (j = 0; j < waiter_cnt; j++)
+        sema_up (&sema);
+      cycles = bench_cycles () - start;
+
+      for (j = 0; j < waiter_cnt; j++)
+        sema_down (&done);
+      for (j = 1; j < waiter_cnt; j++)
+        if (wake_order[j] > wake_order[j - 1])
+          fail ("waiter with priority %d woke after one with priority %d",
+                wake_order[j], wake_order[j - 1]);
+
+      msg ("%d waiters: %"PRIu64" cycles per wakeup.",
+           waiter_cnt, cycles / waiter_cnt);
+    }
+
+  pass ();
+}
+
+static void
+waiter (void *aux UNUSED) 
+{
+  enum intr_level old_level;
+
+  sema_down (&sema);
+  old_level = intr_disable ();
+  wake_order[wake_cnt++] = thread_get_priority ();
+  intr_set_level (old_level);
+  sema_up (&done);
+}
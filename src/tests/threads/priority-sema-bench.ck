@@ -0,0 +1,42 @@
+# -*- perl -*-
+
+# The expected output looks like this, where each N is a number
+# of cycles:
+#
+# (priority-sema-bench) 1 waiters: N cycles per wakeup.
+# (priority-sema-bench) 10 waiters: N cycles per wakeup.
+# (priority-sema-bench) 100 waiters: N cycles per wakeup.
+# (priority-sema-bench) 500 waiters: N cycles per wakeup.
+#
+# Waking the highest-priority waiter from a heap is logarithmic in
+# the number of waiters.  Going from 10 to 500 waiters should add
+# a few sift-down steps, far short of the bound, whereas a scan of
+# the waiters would do 50 times the work.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(priority-sema-bench) PASS', @output);
+
+my (%cycles);
+foreach (@output) {
+    my ($cnt, $c) = /^\(priority-sema-bench\) (\d+) waiters: (\d+) cycles/;
+    $cycles{$cnt} = $c if defined $c;
+}
+foreach my $cnt (10, 500) {
+    fail "No timing for $cnt waiters in output.\n"
+      if !defined $cycles{$cnt};
+}
+fail "Wakeup cost grew from $cycles{10} cycles with 10 waiters "
+  . "to $cycles{500} with 500.\n"
+  if $cycles{500} > 3 * $cycles{10};
+
+pass;
@@ -0,0 +1,72 @@
+/* Measures the cost of a context switch as the number of ready
+   threads grows.  THREAD_CNT threads at the same priority yield
+   to each other round-robin ITER_CNT times each, and the average
+   number of CPU cycles per switch is reported for each size.
+
+   With per-priority run queues, pushing the yielding thread and
+   picking the next one are both constant time, so the reported
+   cost should stay roughly flat from the smallest to the largest
+   thread count. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ITER_CNT 64
+
+static const int thread_cnts[] = {1, 4, 16, 64};
+
+static thread_func yielder;
+
+void
+test_priority_switch_bench (void) 
+{
+  struct semaphore done;
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&done, 0);
+  for (i = 0; i < sizeof thread_cnts / sizeof *thread_cnts; i++) 
+    {
+      int thread_cnt = thread_cnts[i];
+      uint64_t start, cycles;
+      int j;
+
+      for (j = 0; j < thread_cnt; j++) 
+        {
+          char name[16];
+          snprintf (name, sizeof name, "%d", j);
+          thread_create (name, PRI_DEFAULT, yielder, &done);
+        }
+
+      /* The yielders only get to run once we block. */
+      start = bench_cycles ();
+      for (j = 0; j < thread_cnt; j++)
+        sema_down (&done);
+      cycles = bench_cycles () - start;
+
+      msg ("%d threads: %"PRIu64" cycles per switch.",
+           thread_cnt, cycles / ((uint64_t) thread_cnt * ITER_CNT));
+    }
+
+  pass ();
+}
+
+static void
+yielder (void *done_) 
+{
+  struct semaphore *done = done_;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    thread_yield ();
+  sema_up (done);
+}
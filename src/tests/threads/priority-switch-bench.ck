@@ -0,0 +1,42 @@
+# -*- perl -*-
+
+# The expected output looks like this, where each N is a number
+# of cycles:
+#
+# (priority-switch-bench) 1 threads: N cycles per switch.
+# (priority-switch-bench) 4 threads: N cycles per switch.
+# (priority-switch-bench) 16 threads: N cycles per switch.
+# (priority-switch-bench) 64 threads: N cycles per switch.
+#
+# Picking the next thread must not get dearer as more threads are
+# ready.  A lone thread only yields to itself, so 64 threads are
+# compared against 4: scanning the ready threads on every switch
+# would do 16 times the work, which shows up well above the bound.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(priority-switch-bench) PASS', @output);
+
+my (%cycles);
+foreach (@output) {
+    my ($cnt, $c) = /^\(priority-switch-bench\) (\d+) threads: (\d+) cycles/;
+    $cycles{$cnt} = $c if defined $c;
+}
+foreach my $cnt (4, 64) {
+    fail "No timing for $cnt threads in output.\n"
+      if !defined $cycles{$cnt};
+}
+fail "Switch cost grew from $cycles{4} cycles with 4 threads "
+  . "to $cycles{64} with 64.\n"
+  if $cycles{64} > 1.5 * $cycles{4};
+
+pass;
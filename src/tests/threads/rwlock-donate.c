@@ -0,0 +1,62 @@
+/* The main thread acquires a reader-writer lock for writing.
+   Then it creates a higher-priority reader and an even
+   higher-priority writer, both of which block on the lock and
+   donate their priorities to the main thread.  When the main
+   thread releases the lock, the writer should get it first, then
+   the reader, and the main thread's priority should drop back. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_rwlock_donate (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_write (&rw);
+  thread_create ("reader", PRI_DEFAULT + 5, reader_thread_func, &rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  thread_create ("writer", PRI_DEFAULT + 10, writer_thread_func, &rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  rwlock_release_write (&rw);
+  msg ("Reader and writer should have finished by now.");
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_write (rw);
+  msg ("Writer acquired the lock.");
+  rwlock_release_write (rw);
+  msg ("Writer finished.");
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_read (rw);
+  msg ("Reader acquired the lock.");
+  rwlock_release_read (rw);
+  msg ("Reader finished.");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) This thread should have priority 36.  Actual priority: 36.
+(rwlock-donate) This thread should have priority 41.  Actual priority: 41.
+(rwlock-donate) Writer acquired the lock.
+(rwlock-donate) Writer finished.
+(rwlock-donate) Reader acquired the lock.
+(rwlock-donate) Reader finished.
+(rwlock-donate) Reader and writer should have finished by now.
+(rwlock-donate) This thread should have priority 31.  Actual priority: 31.
+(rwlock-donate) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* The main thread acquires a reader-writer lock for reading.
+   Then it creates three higher-priority threads that acquire the
+   same lock for reading.  Readers don't exclude each other, so
+   each of them should get the lock right away. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+
+void
+test_rwlock_readers (void) 
+{
+  struct rwlock rw;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  for (i = 0; i < 3; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT + 1, reader_thread_func, &rw);
+    }
+  msg ("Main thread releasing its read lock.");
+  rwlock_release_read (&rw);
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_read (rw);
+  msg ("%s acquired the lock while others read.", thread_name ());
+  rwlock_release_read (rw);
+}
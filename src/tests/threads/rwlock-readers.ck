@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) reader 0 acquired the lock while others read.
+(rwlock-readers) reader 1 acquired the lock while others read.
+(rwlock-readers) reader 2 acquired the lock while others read.
+(rwlock-readers) Main thread releasing its read lock.
+(rwlock-readers) end
+EOF
+pass;
@@ -0,0 +1,58 @@
+/* The main thread acquires a reader-writer lock for reading.  A
+   higher-priority writer then blocks waiting for it, and an even
+   higher-priority reader arrives after the writer.  Since
+   writers are preferred, the late reader must wait for the writer
+   even though the lock is only held for reading.  When the main
+   thread releases its read lock, the writer should run first,
+   then the reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_rwlock_writer (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rw);
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rw);
+  msg ("Main thread releasing its read lock.");
+  rwlock_release_read (&rw);
+  msg ("Main thread finished.");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  msg ("Writer waiting.");
+  rwlock_acquire_write (rw);
+  msg ("Writer acquired the lock.");
+  rwlock_release_write (rw);
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  msg ("Reader waiting.");
+  rwlock_acquire_read (rw);
+  msg ("Reader acquired the lock.");
+  rwlock_release_read (rw);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer) begin
+(rwlock-writer) Writer waiting.
+(rwlock-writer) Reader waiting.
+(rwlock-writer) Main thread releasing its read lock.
+(rwlock-writer) Writer acquired the lock.
+(rwlock-writer) Reader acquired the lock.
+(rwlock-writer) Main thread finished.
+(rwlock-writer) end
+EOF
+pass;
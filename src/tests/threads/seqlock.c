@@ -0,0 +1,72 @@
+/* A writer thread repeatedly updates a pair of counters under a
+   sequence lock, yielding halfway through each update, while the
+   main thread reads them.  Every read that the sequence lock
+   lets through must see both counters equal. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WRITE_CNT 100
+#define READ_CNT 200
+
+static struct seqlock sl;
+static int first, second;
+
+static thread_func writer_thread_func;
+
+void
+test_seqlock (void) 
+{
+  struct semaphore done;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  seqlock_init (&sl);
+  sema_init (&done, 0);
+  thread_create ("writer", PRI_DEFAULT, writer_thread_func, &done);
+
+  for (i = 0; i < READ_CNT; i++) 
+    {
+      unsigned start;
+      int a, b;
+
+      do
+        {
+          start = seqlock_read_begin (&sl);
+          a = first;
+          thread_yield ();
+          b = second;
+        }
+      while (seqlock_read_retry (&sl, start));
+
+      if (a != b)
+        fail ("read inconsistent counters %d and %d", a, b);
+    }
+  msg ("%d consistent reads.", READ_CNT);
+
+  sema_down (&done);
+  msg ("Counters ended at %d and %d.", first, second);
+}
+
+static void
+writer_thread_func (void *done_) 
+{
+  struct semaphore *done = done_;
+  int i;
+
+  for (i = 0; i < WRITE_CNT; i++) 
+    {
+      seqlock_write_begin (&sl);
+      first++;
+      thread_yield ();
+      second++;
+      seqlock_write_end (&sl);
+      thread_yield ();
+    }
+  sema_up (done);
+}
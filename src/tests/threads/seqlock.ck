@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(seqlock) begin
+(seqlock) 200 consistent reads.
+(seqlock) Counters ended at 100 and 100.
+(seqlock) end
+EOF
+pass;
@@ -25,10 +25,22 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-deep", test_priority_donate_deep},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-switch-bench", test_priority_switch_bench},
+    {"priority-sema-bench", test_priority_sema_bench},
+    {"workqueue", test_workqueue},
+    {"rwlock-readers", test_rwlock_readers},
+    {"rwlock-writer", test_rwlock_writer},
+    {"rwlock-donate", test_rwlock_donate},
+    {"rwlock-bench", test_rwlock_bench},
+    {"seqlock", test_seqlock},
+    {"palloc-bench", test_palloc_bench},
+    {"kmem-cache", test_kmem_cache},
+    {"malloc-bench", test_malloc_bench},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -1,6 +1,8 @@
 #ifndef TESTS_THREADS_TESTS_H
 #define TESTS_THREADS_TESTS_H
 
+#include <stdint.h>
+
 void run_test (const char *);
 
 typedef void test_func (void);
@@ -19,10 +21,22 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_deep;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_switch_bench;
+extern test_func test_priority_sema_bench;
+extern test_func test_workqueue;
+extern test_func test_rwlock_readers;
+extern test_func test_rwlock_writer;
+extern test_func test_rwlock_donate;
+extern test_func test_rwlock_bench;
+extern test_func test_seqlock;
+extern test_func test_palloc_bench;
+extern test_func test_kmem_cache;
+extern test_func test_malloc_bench;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -37,5 +51,15 @@ void msg (const char *, ...);
 void fail (const char *, ...);
 void pass (void);
 
+/* Returns the CPU's time-stamp counter, for benchmarks that
+   need finer resolution than timer_ticks(). */
+static inline uint64_t
+bench_cycles (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 #endif /* tests/threads/tests.h */
 
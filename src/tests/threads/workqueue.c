@@ -0,0 +1,87 @@
+/* Checks the work queue API: queueing, delayed work, cancelling
+   and flushing.  The queue's workers run below our priority, so
+   queued work only runs once we block. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define WORK_CNT 16
+
+static struct workqueue test_wq;
+static int run_cnt;
+static int64_t run_tick;
+
+static work_func counter;
+
+void
+test_workqueue (void) 
+{
+  struct work works[WORK_CNT];
+  struct work delayed;
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  if (!workqueue_create (&test_wq, "test", 2, PRI_DEFAULT - 1))
+    fail ("could not create work queue");
+
+  /* Queue a batch of work and wait for it. */
+  for (i = 0; i < WORK_CNT; i++) 
+    {
+      work_init (&works[i], counter, NULL);
+      if (!queue_work (&test_wq, &works[i]))
+        fail ("queue_work failed");
+    }
+  if (queue_work (&test_wq, &works[0]))
+    fail ("queued pending work twice");
+  workqueue_flush (&test_wq);
+  msg ("%d of %d work items ran.", run_cnt, WORK_CNT);
+
+  /* Cancel pending work before it gets a chance to run. */
+  run_cnt = 0;
+  queue_work (&test_wq, &works[0]);
+  queue_work (&test_wq, &works[1]);
+  if (!work_cancel (&works[0]))
+    fail ("could not cancel pending work");
+  if (work_cancel (&works[0]))
+    fail ("cancelled work twice");
+  workqueue_flush (&test_wq);
+  msg ("%d work item ran after cancelling the other.", run_cnt);
+
+  /* Delayed work runs no earlier than asked. */
+  run_cnt = 0;
+  work_init (&delayed, counter, NULL);
+  start = timer_ticks ();
+  queue_delayed_work (&test_wq, &delayed, 10);
+  if (!work_pending (&delayed))
+    fail ("delayed work not pending");
+  timer_sleep (20);
+  workqueue_flush (&test_wq);
+  msg ("Delayed work ran %s.",
+       run_cnt == 1 && run_tick - start >= 10 ? "on time" : "too early");
+
+  /* Cancelled delayed work never runs. */
+  run_cnt = 0;
+  queue_delayed_work (&test_wq, &delayed, 10);
+  if (!work_cancel (&delayed))
+    fail ("could not cancel delayed work");
+  timer_sleep (20);
+  workqueue_flush (&test_wq);
+  msg ("%d cancelled delayed work items ran.", run_cnt);
+}
+
+static void
+counter (struct work *work UNUSED) 
+{
+  enum intr_level old_level = intr_disable ();
+  run_cnt++;
+  run_tick = timer_ticks ();
+  intr_set_level (old_level);
+}
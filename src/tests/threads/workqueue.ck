@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) 16 of 16 work items ran.
+(workqueue) 1 work item ran after cancelling the other.
+(workqueue) Delayed work ran on time.
+(workqueue) 0 cancelled delayed work items ran.
+(workqueue) end
+EOF
+pass;
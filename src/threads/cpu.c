@@ -0,0 +1,237 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <packed.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/loader.h"
+#include "threads/vaddr.h"
+
+/* Per-CPU state.
+
+   The CPUs are found in the tables defined by the Intel
+   MultiProcessor Specification [MP], which the BIOS (and QEMU
+   when run with -smp) leaves in low memory.  Without them, there
+   is just the bootstrap processor.
+
+   Only the bootstrap processor is brought online.  The rest of
+   the kernel still relies on intr_disable() for mutual exclusion
+   and keeps state such as the current interrupt context in
+   globals, neither of which holds once a second CPU runs kernel
+   code, so the application processors are recorded but left
+   halted.
+
+   This is groundwork only: starting the application processors
+   (INIT/SIPI through the local APIC) and sending them
+   interprocessor interrupts are not done.  The scheduler keeps
+   its ready threads, idle thread and locks per CPU, in struct
+   cpu, so that they need not be redone then.  Until then the
+   spin locks and cpu_current() compile down to what a single
+   CPU needs, unless SMP is defined. */
+
+struct cpu cpus[CPU_MAX];
+int cpu_cnt;                    /* # of CPUs found. */
+int cpu_online_cnt;             /* # of CPUs scheduling threads. */
+
+/* MP floating pointer structure.  See [MP] 4.1. */
+struct mp_float
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of config table. */
+    uint8_t length;             /* Length in 16-byte units. */
+    uint8_t revision;           /* [MP] revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    uint8_t type;               /* Default configuration, if nonzero. */
+    uint8_t features[4];
+  } PACKED;
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of header and entries. */
+    uint8_t revision;           /* [MP] revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_length;
+    uint16_t entry_cnt;         /* # of entries following. */
+    uint32_t lapic;             /* Physical address of local APICs. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  } PACKED;
+
+/* MP configuration table processor entry.  See [MP] 4.3.1. */
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;
+    uint8_t flags;              /* MP_ENABLED, MP_BSP. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  } PACKED;
+
+/* Configuration table entry types and their sizes.  Only
+   processor entries are 20 bytes; the others are 8. */
+#define MP_PROCESSOR 0
+#define MP_PROCESSOR_SIZE 20
+#define MP_OTHER_SIZE 8
+
+/* Processor entry flags. */
+#define MP_ENABLED 0x01         /* Usable. */
+#define MP_BSP 0x02             /* Bootstrap processor. */
+
+static void cpu_init_one (struct cpu *, int id, uint8_t apic_id);
+static void mp_init (void);
+static struct mp_float *mp_search (uintptr_t start, size_t length);
+static bool mp_checksum (const void *, size_t length);
+static void *mp_ptov (uintptr_t paddr, size_t length);
+
+/* Sets up cpus[] with the bootstrap processor, which is brought
+   online, and any other CPUs listed in the MP tables.  Must be
+   called before thread_init(). */
+void
+cpu_init (void) 
+{
+  cpu_init_one (&cpus[0], 0, 0);
+  cpu_cnt = 1;
+  mp_init ();
+
+  cpus[0].online = true;
+  cpu_online_cnt = 1;
+
+  if (cpu_cnt > 1)
+    printf ("%d CPUs found, %d online.\n", cpu_cnt, cpu_online_cnt);
+}
+
+#ifdef SMP
+/* Returns the CPU we are running on. */
+struct cpu *
+cpu_current (void) 
+{
+  uint32_t eax, ebx, ecx, edx;
+  int i;
+
+  if (cpu_online_cnt <= 1)
+    return &cpus[0];
+
+  /* Bits 24 to 31 of EBX from CPUID leaf 1 are our initial
+     local APIC ID.  See [IA32-v2a] "CPUID". */
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].apic_id == ebx >> 24)
+      return &cpus[i];
+  NOT_REACHED ();
+}
+#endif
+
+/* Initializes C as CPU number ID with local APIC ID APIC_ID. */
+static void
+cpu_init_one (struct cpu *c, int id, uint8_t apic_id) 
+{
+  int i;
+
+  memset (c, 0, sizeof *c);
+  c->id = id;
+  c->apic_id = apic_id;
+  spinlock_init (&c->rq.lock);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&c->rq.queues[i]);
+}
+
+/* Adds the CPUs listed in the MP configuration table to cpus[],
+   keeping the bootstrap processor in cpus[0]. */
+static void
+mp_init (void) 
+{
+  struct mp_float *mpf;
+  struct mp_config *config;
+  uint8_t *p, *end;
+  uint16_t ebda;
+
+  /* [MP] 4 says to look in the first kB of the extended BIOS
+     data area, whose segment is stored at 0x40e, then in the
+     last kB of base memory, then in the BIOS ROM. */
+  ebda = *(uint16_t *) ptov (0x40e);
+  mpf = ebda != 0 ? mp_search ((uintptr_t) ebda << 4, 1024) : NULL;
+  if (mpf == NULL)
+    mpf = mp_search (0x9fc00, 1024);
+  if (mpf == NULL)
+    mpf = mp_search (0xf0000, 0x10000);
+  if (mpf == NULL || mpf->config == 0)
+    return;
+
+  config = mp_ptov (mpf->config, sizeof *config);
+  if (config == NULL
+      || memcmp (config->signature, "PCMP", 4)
+      || mp_ptov (mpf->config, config->length) == NULL
+      || !mp_checksum (config, config->length))
+    return;
+
+  p = (uint8_t *) (config + 1);
+  end = (uint8_t *) config + config->length;
+  while (p < end)
+    {
+      if (*p == MP_PROCESSOR)
+        {
+          struct mp_processor *proc = (struct mp_processor *) p;
+          if (proc->flags & MP_BSP)
+            cpus[0].apic_id = proc->apic_id;
+          else if ((proc->flags & MP_ENABLED) && cpu_cnt < CPU_MAX)
+            {
+              cpu_init_one (&cpus[cpu_cnt], cpu_cnt, proc->apic_id);
+              cpu_cnt++;
+            }
+          p += MP_PROCESSOR_SIZE;
+        }
+      else
+        p += MP_OTHER_SIZE;
+    }
+}
+
+/* Looks for an MP floating pointer structure in the LENGTH bytes
+   of physical memory starting at START.  Returns it if found, or
+   a null pointer. */
+static struct mp_float *
+mp_search (uintptr_t start, size_t length) 
+{
+  uint8_t *p = mp_ptov (start, length);
+  uint8_t *end = p + length;
+
+  if (p == NULL)
+    return NULL;
+  for (; p + sizeof (struct mp_float) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && mp_checksum (p, sizeof (struct mp_float)))
+      return (struct mp_float *) p;
+  return NULL;
+}
+
+/* Returns true if the LENGTH bytes at P sum to 0. */
+static bool
+mp_checksum (const void *p_, size_t length) 
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (length-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Returns the kernel virtual address of the LENGTH bytes of
+   physical memory at PADDR, or a null pointer if they are not
+   all mapped. */
+static void *
+mp_ptov (uintptr_t paddr, size_t length) 
+{
+  uintptr_t limit = (uintptr_t) init_ram_pages * PGSIZE;
+
+  if (paddr >= limit || length > limit - paddr)
+    return NULL;
+  return ptov (paddr);
+}
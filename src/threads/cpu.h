@@ -0,0 +1,55 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+
+/* Most CPUs we keep track of. */
+#define CPU_MAX 8
+
+/* A CPU's queue of threads in THREAD_READY state.  There is one
+   FIFO list per priority level, and bit P of BITMAP is set iff
+   QUEUES[P] is non-empty, so the highest-priority ready thread
+   is found with a single find-last-set. */
+struct run_queue
+  {
+    struct spinlock lock;               /* Protects the members below. */
+    struct list queues[PRI_MAX + 1];    /* Ready threads, by priority. */
+    uint64_t bitmap;                    /* Non-empty QUEUES. */
+    size_t cnt;                         /* # of threads in QUEUES. */
+  };
+
+/* Per-CPU state. */
+struct cpu
+  {
+    int id;                     /* Index into cpus[]. */
+    uint8_t apic_id;            /* Local APIC ID, from the MP tables. */
+    bool online;                /* Scheduling threads? */
+    struct thread *idle_thread; /* Runs when RQ is empty. */
+    struct run_queue rq;        /* Threads ready to run here. */
+  };
+
+/* CPUs found at boot.  cpus[0] is the bootstrap processor. */
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+extern int cpu_online_cnt;
+
+void cpu_init (void);
+
+#ifdef SMP
+struct cpu *cpu_current (void);
+#else
+/* Returns the CPU we are running on, which is always the
+   bootstrap processor until the others are started. */
+static inline struct cpu *
+cpu_current (void) 
+{
+  return &cpus[0];
+}
+#endif
+
+#endif /* threads/cpu.h */
@@ -1,6 +1,18 @@
 #include <stdint.h>
 #define _F (1<<14)
 
+/* Lab1 - MLFQS */
+/* Precomputed load_avg coefficients, 59/60 and 1/60.  These are
+   the exact values fp_div (int_fp (59), int_fp (60)) and
+   fp_div (int_fp (1), int_fp (60)) produce. */
+#define FP_LOAD_DECAY ((59 * _F) / 60)
+#define FP_LOAD_GAIN (_F / 60)
+
+/* Number of per-second recent_cpu decay coefficients remembered,
+   that is, how many seconds a thread's recent_cpu may fall behind
+   before it must be brought up to date. */
+#define FP_DECAY_EPOCHS 64
+
 int int_fp (int n);
 int fp_int (int x);
 int fp_int_round (int x);
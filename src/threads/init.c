@@ -15,13 +15,17 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/profile.h"
+#include "threads/schedtrace.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -41,6 +45,9 @@
 /* Lab3 - frame table */
 #include "vm/falloc.h"
 
+/* lab3 - supplemental page table */
+#include "vm/spt.h"
+
 /* lab3 - swap table */
 #include "vm/swap.h"
 
@@ -63,6 +70,10 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -wm: Free user frame watermarks for the page-out daemon, or 0
+   to size them from the user pool. */
+static size_t pageout_low_wm, pageout_high_wm;
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -91,8 +102,9 @@ main (void)
   argv = read_command_line ();
   argv = parse_options (argv);
 
-  /* Initialize ourselves as a thread so we can use locks,
-     then enable console locking. */
+  /* Find the CPUs, then initialize ourselves as a thread so we
+     can use locks, then enable console locking. */
+  cpu_init ();
   thread_init ();
   console_init ();  
 
@@ -125,6 +137,10 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  schedtrace_init ();
+  profile_init ();
+  palloc_zero_init ();
+  workqueue_init ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -134,7 +150,10 @@ main (void)
 #endif
 
   /* lab3 - frame table */
-  frame_table_init ();
+  frame_table_init (pageout_low_wm, pageout_high_wm);
+
+  /* lab3 - supplemental page table */
+  init_spte_cache ();
 
   /* lab3 - swap table */
   init_swap ();
@@ -268,9 +287,21 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-nohz"))
+        timer_nohz = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-wm"))
+        {
+          char *high = value != NULL ? strchr (value, ',') : NULL;
+          if (high == NULL)
+            PANIC ("-wm requires LOW,HIGH");
+          pageout_low_wm = atoi (value);
+          pageout_high_wm = atoi (high + 1);
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -391,8 +422,12 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -nohz              Stop the periodic timer tick while idle.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -wm=LOW,HIGH       Reclaim frames below LOW free until HIGH.\n"
 #endif
           );
   shutdown_power_off ();
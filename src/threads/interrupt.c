@@ -359,6 +359,10 @@ intr_handler (struct intr_frame *frame)
 
       in_external_intr = true;
       yield_on_return = false;
+
+      /* With -nohz, an interrupt may end an idle halt before the
+         next tick: let the timer catch up at the next boundary. */
+      timer_idle_exit ();
     }
 
   /* Invoke the interrupt's handler. */
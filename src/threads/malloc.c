@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,7 +34,44 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of each descriptor sits a magazine layer, after
+   Bonwick and Adams.  A magazine is an array of up to MAG_ROUNDS
+   free blocks of one size.  Each CPU has two magazines per
+   descriptor, LOADED and PREVIOUS, and malloc() and free() of
+   small blocks pop from and push onto them with only interrupts
+   disabled, without touching the descriptor's lock.  When both
+   are empty (for malloc()) or full (for free()), the descriptor's
+   "depot" of full and empty magazines is visited under the lock
+   to exchange one.  Blocks in magazines count as in use as far
+   as their arenas are concerned, so the depot keeps at most
+   DEPOT_MAX full magazines and returns the blocks of any more
+   to their arenas. */
+
+/* Number of blocks a magazine holds. */
+#define MAG_ROUNDS 15
+
+/* Most full magazines kept in a descriptor's depot. */
+#define DEPOT_MAX 4
+
+/* Magazine. */
+struct magazine
+  {
+    struct list_elem elem;      /* Element in depot or mag_free_list. */
+    size_t cnt;                 /* Number of blocks in ROUNDS. */
+    void *rounds[MAG_ROUNDS];   /* Free blocks. */
+  };
+
+/* A CPU's magazines for one descriptor.  Only accessed by that
+   CPU, with interrupts disabled. */
+struct mag_cpu
+  {
+    struct magazine *loaded;    /* Magazine in use, or null. */
+    struct magazine *previous;  /* Full or empty spare, or null. */
+    long long hits;             /* Calls served from a magazine. */
+    long long misses;           /* Calls that went to the depot. */
+  };
 
 /* Descriptor. */
 struct desc
@@ -41,6 +80,10 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    struct list full_mags;      /* Depot: full magazines. */
+    size_t full_cnt;            /* Number of magazines in FULL_MAGS. */
+    struct list empty_mags;     /* Depot: empty magazines. */
+    struct mag_cpu cpus[CPU_MAX]; /* Per-CPU magazines. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -64,8 +107,20 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Unused magazines, carved out of pages of their own so that
+   getting one never recurses into malloc().  Accessed with
+   interrupts disabled. */
+static struct list mag_free_list;
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *mag_alloc (struct desc *);
+static bool mag_free (struct desc *, struct block *);
+static void *depot_alloc (struct desc *);
+static bool depot_free (struct desc *, struct block *);
+static struct block *desc_alloc (struct desc *);
+static void desc_free (struct desc *, struct block *);
+static struct magazine *magazine_get (void);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -81,7 +136,12 @@ malloc_init (void)
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      list_init (&d->full_mags);
+      d->full_cnt = 0;
+      list_init (&d->empty_mags);
+      memset (d->cpus, 0, sizeof d->cpus);
     }
+  list_init (&mag_free_list);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -119,36 +179,14 @@ malloc (size_t size)
       return a + 1;
     }
 
+  /* Try this CPU's magazines, then the depot. */
+  b = mag_alloc (d);
+  if (b != NULL)
+    return b;
   lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
-    {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
-    }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  b = depot_alloc (d);
+  if (b == NULL)
+    b = desc_alloc (d);
   lock_release (&d->lock);
   return b;
 }
@@ -232,26 +270,13 @@ free (void *p)
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
-            {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
-            }
 
+          /* Try this CPU's magazines, then the depot. */
+          if (mag_free (d, b))
+            return;
+          lock_acquire (&d->lock);
+          if (!depot_free (d, b))
+            desc_free (d, b);
           lock_release (&d->lock);
         }
       else
@@ -263,6 +288,265 @@ free (void *p)
     }
 }
 
+/* Prints malloc() statistics: for each descriptor, how many
+   small-block calls were served from magazines, how many had to
+   go to the depot, and how many full magazines the depot holds. */
+void
+malloc_print_stats (void)
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    {
+      long long hits = 0, misses = 0;
+      int i;
+
+      for (i = 0; i < CPU_MAX; i++)
+        {
+          hits += d->cpus[i].hits;
+          misses += d->cpus[i].misses;
+        }
+      if (hits + misses > 0)
+        printf ("Malloc %zu-byte blocks: %lld magazine hits, %lld misses, "
+                "%zu full magazines in depot\n",
+                d->block_size, hits, misses, d->full_cnt);
+    }
+}
+
+/* Pops a block off one of the current CPU's magazines for D and
+   returns it, or returns a null pointer if both are empty. */
+static void *
+mag_alloc (struct desc *d)
+{
+  enum intr_level old_level = intr_disable ();
+  struct mag_cpu *mc = &d->cpus[cpu_current ()->id];
+  void *b = NULL;
+
+  if (mc->loaded == NULL || mc->loaded->cnt == 0)
+    {
+      struct magazine *m = mc->loaded;
+      mc->loaded = mc->previous;
+      mc->previous = m;
+    }
+  if (mc->loaded != NULL && mc->loaded->cnt > 0)
+    {
+      b = mc->loaded->rounds[--mc->loaded->cnt];
+      mc->hits++;
+    }
+  else
+    mc->misses++;
+  intr_set_level (old_level);
+  return b;
+}
+
+/* Pushes block B onto one of the current CPU's magazines for D
+   and returns true, or returns false if both are full. */
+static bool
+mag_free (struct desc *d, struct block *b)
+{
+  enum intr_level old_level = intr_disable ();
+  struct mag_cpu *mc = &d->cpus[cpu_current ()->id];
+  bool success = false;
+
+  if (mc->loaded == NULL || mc->loaded->cnt == MAG_ROUNDS)
+    {
+      struct magazine *m = mc->loaded;
+      mc->loaded = mc->previous;
+      mc->previous = m;
+    }
+  if (mc->loaded != NULL && mc->loaded->cnt < MAG_ROUNDS)
+    {
+      mc->loaded->rounds[mc->loaded->cnt++] = b;
+      mc->hits++;
+      success = true;
+    }
+  else
+    mc->misses++;
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Exchanges the current CPU's empty PREVIOUS magazine for D for
+   a full one from the depot and takes a block from it.  Returns
+   the block, or a null pointer if the depot has no full
+   magazine.  D's lock must be held. */
+static void *
+depot_alloc (struct desc *d)
+{
+  enum intr_level old_level;
+  struct mag_cpu *mc;
+  struct magazine *m;
+  void *b;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  if (list_empty (&d->full_mags))
+    return NULL;
+  m = list_entry (list_pop_front (&d->full_mags), struct magazine, elem);
+  d->full_cnt--;
+
+  /* Another thread may have run on this CPU since mag_alloc(),
+     so take the magazines as we find them. */
+  old_level = intr_disable ();
+  mc = &d->cpus[cpu_current ()->id];
+  if (mc->previous != NULL)
+    {
+      if (mc->previous->cnt == 0)
+        list_push_front (&d->empty_mags, &mc->previous->elem);
+      else
+        {
+          list_push_front (&d->full_mags, &mc->previous->elem);
+          d->full_cnt++;
+        }
+    }
+  mc->previous = mc->loaded;
+  mc->loaded = m;
+  b = m->rounds[--m->cnt];
+  intr_set_level (old_level);
+  return b;
+}
+
+/* Exchanges the current CPU's full PREVIOUS magazine for D for an
+   empty one and puts block B in it.  Returns true if successful,
+   false if no empty magazine could be found.  D's lock must be
+   held. */
+static bool
+depot_free (struct desc *d, struct block *b)
+{
+  enum intr_level old_level;
+  struct mag_cpu *mc;
+  struct magazine *m, *full = NULL;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  if (!list_empty (&d->empty_mags))
+    m = list_entry (list_pop_front (&d->empty_mags), struct magazine, elem);
+  else
+    {
+      m = magazine_get ();
+      if (m == NULL)
+        return false;
+    }
+  m->rounds[0] = b;
+  m->cnt = 1;
+
+  old_level = intr_disable ();
+  mc = &d->cpus[cpu_current ()->id];
+  full = mc->previous;
+  mc->previous = mc->loaded;
+  mc->loaded = m;
+  intr_set_level (old_level);
+
+  /* Put the displaced magazine in the depot.  Past DEPOT_MAX
+     full magazines, give its blocks back to their arenas. */
+  if (full != NULL && full->cnt > 0 && d->full_cnt >= DEPOT_MAX)
+    while (full->cnt > 0)
+      desc_free (d, full->rounds[--full->cnt]);
+  if (full != NULL)
+    {
+      if (full->cnt > 0)
+        {
+          list_push_front (&d->full_mags, &full->elem);
+          d->full_cnt++;
+        }
+      else
+        list_push_front (&d->empty_mags, &full->elem);
+    }
+  return true;
+}
+
+/* Takes a block from D's free list, creating a new arena if the
+   list is empty, and returns it.  Returns a null pointer if no
+   page is available for a new arena.  D's lock must be held. */
+static struct block *
+desc_alloc (struct desc *d)
+{
+  struct block *b;
+  struct arena *a;
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = palloc_get_page (0);
+      if (a == NULL) 
+        return NULL; 
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+    }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  return b;
+}
+
+/* Puts block B on D's free list, freeing its arena if that
+   leaves the arena entirely unused.  D's lock must be held. */
+static void
+desc_free (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      palloc_free_page (a);
+    }
+}
+
+/* Returns an unused magazine, or a null pointer if none is
+   available. */
+static struct magazine *
+magazine_get (void)
+{
+  enum intr_level old_level;
+  struct magazine *m = NULL;
+
+  old_level = intr_disable ();
+  if (list_empty (&mag_free_list))
+    {
+      /* Carve a new page into magazines.  palloc_get_page() may
+         sleep, so do that with interrupts on. */
+      struct magazine *page;
+      size_t i;
+
+      intr_set_level (old_level);
+      page = palloc_get_page (0);
+      if (page == NULL)
+        return NULL;
+      old_level = intr_disable ();
+      for (i = 0; i < PGSIZE / sizeof *page; i++)
+        list_push_back (&mag_free_list, &page[i].elem);
+    }
+  m = list_entry (list_pop_front (&mag_free_list), struct magazine, elem);
+  intr_set_level (old_level);
+  m->cnt = 0;
+  return m;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
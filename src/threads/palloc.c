@@ -2,6 +2,7 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -9,6 +10,7 @@
 #include <string.h>
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +25,77 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept as blocks of 2**ORDER pages, each aligned to its own size
+   within the pool, on one free list per order.  An allocation
+   takes a block from the smallest order that has one, splitting
+   it in halves down to the size needed, so it costs O(log n)
+   whatever the pool's occupancy.  A request that is not a power
+   of two gets the next larger block and gives back the pages
+   beyond the request right away.  Freed blocks merge with their
+   buddies, the other halves they were split from, whenever those
+   are free too, which keeps free memory in large blocks.
+
+   Besides its buddy system, each pool keeps a list of free pages
+   that are already filled with zeros, which the "zero" thread
+   tops up in the background from the buddy system whenever the
+   CPU has nothing better to do.  Single-page PAL_ZERO requests
+   take from that list first and skip their memset().  The list's
+   pages still count as free: requests the buddy system cannot
+   satisfy fall back on them. */
+
+/* Largest block, as an order: 2**MAX_ORDER pages. */
+#define MAX_ORDER 16
+
+/* Header of a free block, kept in its first page. */
+struct free_block
+  {
+    struct list_elem elem;              /* Element in free list. */
+  };
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct bitmap *used_map;            /* Bitmap of allocated pages. */
+    uint8_t *free_orders;               /* Per page: 1 + order of the
+                                           free block it starts, or 0. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    size_t free_cnt;                    /* Number of free pages. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks by order. */
+    size_t block_cnts[MAX_ORDER + 1];   /* Sizes of FREE_LISTS. */
+    struct list zero_list;              /* Free pages filled with zeros. */
+    size_t zero_cnt;                    /* Size of ZERO_LIST. */
+    size_t zero_max;                    /* Number of zeroed pages wanted. */
+    long long zero_hits;                /* PAL_ZERO from ZERO_LIST. */
+    long long zero_misses;              /* PAL_ZERO needing memset(). */
+    const char *name;                   /* For statistics. */
   };
 
+/* Most pre-zeroed pages kept per pool, and the largest share of
+   a pool, as a divisor, that they may take up. */
+#define ZERO_MAX 64
+#define ZERO_SHARE 16
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Wakes up the zero thread when a pool's zeroed pages run low. */
+static struct semaphore zero_sema;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
-static bool page_from_pool (const struct pool *, void *page);
+static bool page_from_pool (const struct pool *, const void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void print_pool_stats (const struct pool *);
+static void *zero_list_pop (struct pool *);
+static void zero_list_drain (struct pool *);
+static bool zero_list_low (const struct pool *);
+static thread_func zero_thread;
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -59,6 +116,16 @@ palloc_init (size_t user_page_limit)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+  sema_init (&zero_sema, 0);
+}
+
+/* Starts the thread that keeps the pools' pre-zeroed pages
+   topped up.  Must be called after thread_start(). */
+void
+palloc_zero_init (void)
+{
+  sema_up (&zero_sema);
+  thread_create ("zero", PRI_MIN, zero_thread, NULL);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -71,24 +138,48 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  void *pages = NULL;
+  bool zeroed = false, wake;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  if (page_cnt == 1 && (flags & PAL_ZERO))
+    zeroed = (pages = zero_list_pop (pool)) != NULL;
+  if (pages == NULL)
+    {
+      page_idx = buddy_alloc (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR && pool->zero_cnt > 0)
+        {
+          /* Out of pages but for the zeroed ones. */
+          if (page_cnt == 1)
+            zeroed = (pages = zero_list_pop (pool)) != NULL;
+          else
+            {
+              zero_list_drain (pool);
+              page_idx = buddy_alloc (pool, page_cnt);
+            }
+        }
+      if (page_idx != BITMAP_ERROR)
+        pages = pool->base + PGSIZE * page_idx;
+    }
+  if (flags & PAL_ZERO)
+    {
+      if (zeroed)
+        pool->zero_hits++;
+      else
+        pool->zero_misses++;
+    }
+  wake = zero_list_low (pool);
   lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  if (wake)
+    sema_up (&zero_sema);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -119,6 +210,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  bool wake;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +229,14 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  lock_acquire (&pool->lock);
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  buddy_free (pool, page_idx, page_cnt);
+  wake = zero_list_low (pool);
+  lock_release (&pool->lock);
+  if (wake)
+    sema_up (&zero_sema);
 }
 
 /* Frees the page at PAGE. */
@@ -148,35 +246,324 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void)
+{
+  return user_pool.page_cnt;
+}
+
+/* Returns the number of free pages in the user pool, counting
+   those kept pre-zeroed.  Does not take the pool's lock, so the
+   count may already be stale, which is fine for deciding when to
+   reclaim memory. */
+size_t
+palloc_user_free_cnt (void)
+{
+  return user_pool.free_cnt + user_pool.zero_cnt;
+}
+
+/* Returns the index within the user pool of PAGE, which must have
+   been allocated from it, counting from 0 up to
+   palloc_user_page_cnt(). */
+size_t
+palloc_user_page_idx (const void *page)
+{
+  ASSERT (page_from_pool (&user_pool, page));
+  return pg_no (page) - pg_no (user_pool.base);
+}
+
+/* Prints page allocator statistics: for each pool, its free
+   pages, its free blocks of each order, and how fragmented its
+   free memory is, as the share of free pages outside the largest
+   free block. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool);
+  print_pool_stats (&user_pool);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
+  /* We'll put the pool's used_map and free_orders at its base.
+     Calculate the space needed for them and subtract it from the
+     pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t meta_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
+  if (meta_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  page_cnt -= meta_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->free_orders = (uint8_t *) base + bm_size;
+  memset (p->free_orders, 0, page_cnt);
+  p->base = base + meta_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = 0;
+  for (order = 0; order <= MAX_ORDER; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->block_cnts[order] = 0;
+    }
+  list_init (&p->zero_list);
+  p->zero_cnt = 0;
+  p->zero_max = page_cnt / ZERO_SHARE < ZERO_MAX ? page_cnt / ZERO_SHARE
+                                                 : ZERO_MAX;
+  p->zero_hits = p->zero_misses = 0;
+  p->name = name;
+
+  /* Every page starts out free. */
+  buddy_free (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
-page_from_pool (const struct pool *pool, void *page) 
+page_from_pool (const struct pool *pool, const void *page) 
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the free block header for page PAGE_IDX in POOL. */
+static struct free_block *
+block_at (const struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Puts the block of 2**ORDER pages at PAGE_IDX in POOL on its
+   free list, without merging it with its buddy. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  list_push_front (&pool->free_lists[order], &block_at (pool, page_idx)->elem);
+  pool->free_orders[page_idx] = order + 1;
+  pool->block_cnts[order]++;
+}
+
+/* Takes the free block of 2**ORDER pages at PAGE_IDX in POOL off
+   its free list. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->free_orders[page_idx] == order + 1);
+  list_remove (&block_at (pool, page_idx)->elem);
+  pool->free_orders[page_idx] = 0;
+  pool->block_cnts[order]--;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL, merging
+   it with its buddy for as long as the buddy is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  for (; order < MAX_ORDER; order++)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx + ((size_t) 1 << order) > pool->page_cnt
+          || pool->free_orders[buddy_idx] != order + 1)
+        break;
+      remove_block (pool, buddy_idx, order);
+      page_idx &= ~((size_t) 1 << order);
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, which need not
+   be a single block: the range is freed as the largest aligned
+   blocks that make it up. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  pool->free_cnt += page_cnt;
+  while (page_cnt > 0)
+    {
+      int order = 0;
+      while (order < MAX_ORDER
+             && (page_idx & (((size_t) 2 << order) - 1)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  struct free_block *b;
+  size_t page_idx, block_cnt;
+  int order, want;
+
+  /* Find the smallest free block that is large enough. */
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want == MAX_ORDER)
+      return BITMAP_ERROR;
+  for (order = want; list_empty (&pool->free_lists[order]); order++)
+    if (order == MAX_ORDER)
+      return BITMAP_ERROR;
+  b = list_entry (list_front (&pool->free_lists[order]),
+                  struct free_block, elem);
+  page_idx = pg_no (b) - pg_no (pool->base);
+  remove_block (pool, page_idx, order);
+
+  /* Split it, freeing the upper halves, down to the size
+     wanted. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+  pool->free_cnt -= (size_t) 1 << order;
+
+  /* Give back the pages beyond PAGE_CNT. */
+  block_cnt = (size_t) 1 << order;
+  if (page_cnt < block_cnt)
+    buddy_free (pool, page_idx + page_cnt, block_cnt - page_cnt);
+
+  ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  return page_idx;
+}
+
+/* Prints statistics for POOL. */
+static void
+print_pool_stats (const struct pool *pool)
+{
+  size_t largest = 0;
+  int order, top = 0;
+
+  for (order = 0; order <= MAX_ORDER; order++)
+    if (pool->block_cnts[order] > 0)
+      {
+        largest = (size_t) 1 << order;
+        top = order;
+      }
+  printf ("Palloc %s: %zu of %zu pages free, largest free block %zu pages, "
+          "%zu%% fragmented\n",
+          pool->name, pool->free_cnt, pool->page_cnt, largest,
+          pool->free_cnt > 0 ? 100 - largest * 100 / pool->free_cnt : 0);
+  printf ("Palloc %s free blocks by order:", pool->name);
+  for (order = 0; order <= top; order++)
+    printf (" %zu", pool->block_cnts[order]);
+  printf ("\n");
+  printf ("Palloc %s: %zu of %zu zeroed pages ready, "
+          "%lld zeroed hits, %lld misses\n",
+          pool->name, pool->zero_cnt, pool->zero_max,
+          pool->zero_hits, pool->zero_misses);
+}
+
+/* Takes a page off POOL's list of zeroed pages and returns it,
+   or returns a null pointer if the list is empty.  POOL's lock
+   must be held. */
+static void *
+zero_list_pop (struct pool *pool)
+{
+  struct free_block *b;
+
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  if (list_empty (&pool->zero_list))
+    return NULL;
+  pool->zero_cnt--;
+
+  /* The list element was the only part of the page not zero. */
+  b = list_entry (list_pop_front (&pool->zero_list), struct free_block, elem);
+  memset (b, 0, sizeof *b);
+  return b;
+}
+
+/* Gives all of POOL's zeroed pages back to its buddy system, so
+   that they can be merged into larger blocks.  POOL's lock must
+   be held. */
+static void
+zero_list_drain (struct pool *pool)
+{
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  while (!list_empty (&pool->zero_list))
+    {
+      struct free_block *b = list_entry (list_pop_front (&pool->zero_list),
+                                         struct free_block, elem);
+      size_t page_idx = pg_no (b) - pg_no (pool->base);
+
+      bitmap_reset (pool->used_map, page_idx);
+      buddy_free (pool, page_idx, 1);
+    }
+  pool->zero_cnt = 0;
+}
+
+/* Returns true if POOL has less than half the zeroed pages it
+   wants and free pages to zero. */
+static bool
+zero_list_low (const struct pool *pool)
+{
+  return pool->zero_cnt < pool->zero_max / 2 && pool->free_cnt > 0;
+}
+
+/* Zeroes free pages into the pools' zero lists until each holds
+   its zero_max pages or runs out of free pages, then waits for
+   zero_sema to be raised when one runs low.  The thread runs at
+   the lowest priority, so it only uses time the CPU would
+   otherwise spend idle. */
+static void
+zero_thread (void *aux UNUSED)
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+
+  if (thread_mlfqs)
+    thread_set_nice (NICE_MAX);
+  for (;;)
+    {
+      size_t i;
+
+      sema_down (&zero_sema);
+      for (i = 0; i < sizeof pools / sizeof *pools; i++)
+        {
+          struct pool *pool = pools[i];
+
+          lock_acquire (&pool->lock);
+          while (pool->zero_cnt < pool->zero_max)
+            {
+              size_t page_idx = buddy_alloc (pool, 1);
+              struct free_block *b;
+
+              if (page_idx == BITMAP_ERROR)
+                break;
+
+              /* Zero the page with the lock held, so that it is
+                 never missing from both the buddy system and the
+                 zero list while an allocation may need it.  An
+                 allocation that has to wait donates its priority,
+                 so a page takes no longer than a memset(). */
+              b = (struct free_block *) (pool->base + PGSIZE * page_idx);
+              memset (b, 0, PGSIZE);
+              list_push_front (&pool->zero_list, &b->elem);
+              pool->zero_cnt++;
+
+              /* Let waiting allocations in between pages. */
+              lock_release (&pool->lock);
+              lock_acquire (&pool->lock);
+            }
+          lock_release (&pool->lock);
+        }
+    }
+}
@@ -0,0 +1,195 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/pagedir.h"
+#endif
+#ifdef FILESYS
+#include "filesys/fsutil.h"
+#endif
+
+#ifdef PROFILE
+
+/* Pages of profile buffer, including the header. */
+#define PROFILE_PAGES 64
+
+/* Profile buffer: a struct profile_header followed by an open
+   addressing hash table of call stacks.  A record with zero
+   samples is an empty slot. */
+static void *buffer;
+static struct profile_record *table;
+static size_t table_size;       /* # of records TABLE can hold. */
+static size_t record_cnt;       /* # of slots in use. */
+static uint32_t sample_cnt;     /* # of samples taken. */
+static uint32_t dropped_cnt;    /* # of samples that did not fit. */
+
+static int walk_kernel (const struct intr_frame *, uint32_t *pcs);
+static int walk_user (const struct intr_frame *, uint32_t *pcs);
+
+/* Allocates the profile buffer.  Timer interrupts before this is
+   called are not sampled.  Must be called after the page
+   allocator is initialized. */
+void
+profile_init (void)
+{
+  buffer = palloc_get_multiple (PAL_ZERO, PROFILE_PAGES);
+  if (buffer == NULL)
+    {
+      printf ("profile: no memory for profile buffer\n");
+      return;
+    }
+  table_size = ((PROFILE_PAGES * PGSIZE - sizeof (struct profile_header))
+                / sizeof (struct profile_record));
+  table = (struct profile_record *) ((struct profile_header *) buffer + 1);
+}
+
+/* Counts a sample of the context interrupted with frame F.
+   Called from the timer interrupt. */
+void
+profile_sample (const struct intr_frame *f)
+{
+  struct profile_record *r;
+  uint32_t pcs[PROFILE_DEPTH];
+  bool user = (f->cs & 3) == 3;
+  int depth;
+  size_t i, probes;
+
+  ASSERT (intr_context ());
+
+  if (table == NULL)
+    return;
+  sample_cnt++;
+
+  memset (pcs, 0, sizeof pcs);
+  pcs[0] = (uint32_t) f->eip;
+  depth = 1 + (user ? walk_user (f, pcs + 1) : walk_kernel (f, pcs + 1));
+
+  /* Linear probing from the stack's hash.  Unused entries of PCS
+     are zero, so equal stacks compare equal as a whole. */
+  i = hash_bytes (pcs, sizeof pcs) % table_size;
+  for (probes = 0; probes < table_size; probes++)
+    {
+      r = &table[i];
+      if (r->samples == 0)
+        {
+          r->depth = depth;
+          r->user = user;
+          memcpy (r->pcs, pcs, sizeof pcs);
+          record_cnt++;
+          break;
+        }
+      if (r->user == user && !memcmp (r->pcs, pcs, sizeof pcs))
+        break;
+      if (++i == table_size)
+        i = 0;
+    }
+  if (probes < table_size)
+    r->samples++;
+  else
+    dropped_cnt++;
+}
+
+/* Stores the return addresses of up to PROFILE_DEPTH - 1 kernel
+   frames of the interrupted context F into PCS, innermost first,
+   and returns how many were stored.  Kernel code runs on the
+   current thread's stack page, so frames outside it end the
+   walk, as does a frame pointer that does not move up the
+   stack. */
+static int
+walk_kernel (const struct intr_frame *f, uint32_t *pcs)
+{
+  uint8_t *stack = pg_round_down (thread_current ());
+  uint32_t *frame = (uint32_t *) f->ebp;
+  int depth = 0;
+
+  while (depth < PROFILE_DEPTH - 1
+         && pg_round_down (frame) == stack
+         && pg_ofs (frame) <= PGSIZE - 2 * sizeof *frame
+         && frame[1] != 0)
+    {
+      pcs[depth++] = frame[1];
+      if (frame[0] <= (uint32_t) frame)
+        break;
+      frame = (uint32_t *) frame[0];
+    }
+  return depth;
+}
+
+/* Like walk_kernel(), but for a user context.  User memory is
+   read through the kernel's mapping of the pages the process
+   has present, so a frame on an unmapped or evicted page ends
+   the walk instead of faulting. */
+static int
+walk_user (const struct intr_frame *f UNUSED, uint32_t *pcs UNUSED)
+{
+  int depth = 0;
+#ifdef USERPROG
+  uint32_t *pd = thread_current ()->pagedir;
+  uint32_t frame = f->ebp;
+
+  while (depth < PROFILE_DEPTH - 1 && pd != NULL
+         && is_user_vaddr ((void *) frame) && frame >= PGSIZE
+         && pg_ofs ((void *) frame) <= PGSIZE - 2 * sizeof (uint32_t))
+    {
+      uint32_t *kframe = pagedir_get_page (pd, (void *) frame);
+      if (kframe == NULL || kframe[1] == 0)
+        break;
+      pcs[depth++] = kframe[1];
+      if (kframe[0] <= frame)
+        break;
+      frame = kframe[0];
+    }
+#endif
+  return depth;
+}
+
+/* Stops sampling and appends the profile to the scratch device
+   as "profile".  Called at shutdown. */
+void
+profile_dump (void)
+{
+  struct profile_header *h = buffer;
+  struct profile_record *t;
+  enum intr_level old_level;
+  size_t i, cnt;
+
+  if (table == NULL)
+    return;
+
+  /* Stop sampling, then pack the used slots to the front. */
+  old_level = intr_disable ();
+  t = table;
+  table = NULL;
+  intr_set_level (old_level);
+  for (i = cnt = 0; i < table_size; i++)
+    if (t[i].samples != 0)
+      t[cnt++] = t[i];
+  ASSERT (cnt == record_cnt);
+
+  memcpy (h->magic, "PROFILE", sizeof h->magic);
+  h->version = PROFILE_VERSION;
+  h->record_size = sizeof (struct profile_record);
+  h->record_cnt = cnt;
+  h->samples = sample_cnt;
+  h->dropped = dropped_cnt;
+  h->hz = TIMER_FREQ;
+
+#ifdef FILESYS
+  if (fsutil_append_buffer ("profile", buffer, sizeof *h + cnt * sizeof *t))
+    printf ("profile: %"PRIu32" samples in %zu stacks written to "
+            "scratch device\n", sample_cnt, cnt);
+  else
+#endif
+    printf ("profile: no scratch device, %"PRIu32" samples discarded\n",
+            sample_cnt);
+}
+#endif /* PROFILE */
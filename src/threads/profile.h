@@ -0,0 +1,61 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdint.h>
+
+/* Sampling CPU profiler.
+
+   Building with "make PROFILE=1" defines PROFILE and compiles
+   everything with frame pointers.  On every timer interrupt the
+   profiler then takes the interrupted instruction pointer and a
+   short frame-pointer backtrace, in kernel or user context, and
+   counts it in a table of distinct call stacks.  At shutdown the
+   table is appended to the scratch device as a file named
+   "profile", which can be fetched with "pintos -g profile" and
+   turned into a flat profile or collapsed stacks on the host
+   with "backtrace --profile".  Without the flag, the profiler
+   compiles to nothing. */
+
+/* Deepest call stack recorded, counting the interrupted
+   instruction itself. */
+#define PROFILE_DEPTH 8
+
+/* One distinct call stack, as stored in the table and on disk.
+   All fields are little-endian. */
+struct profile_record
+  {
+    uint32_t samples;           /* # of samples with this stack. */
+    uint8_t depth;              /* # of entries in PCS that are used. */
+    uint8_t user;               /* 1 if sampled in user context. */
+    uint16_t reserved;
+    uint32_t pcs[PROFILE_DEPTH]; /* Innermost first. */
+  };
+
+/* Header at the start of the dump.  Records follow, in no
+   particular order. */
+struct profile_header
+  {
+    char magic[8];              /* "PROFILE" plus a null. */
+    uint32_t version;           /* PROFILE_VERSION. */
+    uint32_t record_size;       /* sizeof (struct profile_record). */
+    uint32_t record_cnt;        /* # of records that follow. */
+    uint32_t samples;           /* # of samples taken. */
+    uint32_t dropped;           /* # of samples lost to a full table. */
+    uint32_t hz;                /* Samples per second. */
+  };
+
+#define PROFILE_VERSION 1
+
+#ifdef PROFILE
+struct intr_frame;
+
+void profile_init (void);
+void profile_sample (const struct intr_frame *);
+void profile_dump (void);
+#else
+#define profile_init() ((void) 0)
+#define profile_sample(FRAME) ((void) 0)
+#define profile_dump() ((void) 0)
+#endif
+
+#endif /* threads/profile.h */
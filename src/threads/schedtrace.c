@@ -0,0 +1,146 @@
+#include "threads/schedtrace.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/palloc.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef FILESYS
+#include "filesys/fsutil.h"
+#endif
+
+#ifdef SCHEDTRACE
+
+/* Pages of trace buffer, including the header. */
+#define SCHEDTRACE_PAGES 32
+
+/* Trace buffer: a struct schedtrace_header followed by a ring of
+   records.  The header's size is a multiple of the record size,
+   so the whole buffer can be written out as one file. */
+static void *buffer;
+static struct schedtrace_record *ring;
+static size_t ring_size;        /* # of records RING can hold. */
+static size_t ring_head;        /* Index of the next record to write. */
+static uint64_t record_cnt;     /* # of records ever written. */
+static struct spinlock ring_lock;
+
+/* Time stamp counter and timer ticks at schedtrace_init(), to
+   find the counter's frequency at dump time. */
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Allocates the trace buffer.  Events before this is called are
+   not recorded.  Must be called after the page allocator and
+   timer are initialized. */
+void
+schedtrace_init (void) 
+{
+  ASSERT (sizeof (struct schedtrace_header)
+          % sizeof (struct schedtrace_record) == 0);
+
+  spinlock_init (&ring_lock);
+  buffer = palloc_get_multiple (PAL_ZERO, SCHEDTRACE_PAGES);
+  if (buffer == NULL)
+    {
+      printf ("schedtrace: no memory for trace buffer\n");
+      return;
+    }
+  ring_size = ((SCHEDTRACE_PAGES * PGSIZE - sizeof (struct schedtrace_header))
+               / sizeof (struct schedtrace_record));
+  start_tsc = rdtsc ();
+  start_ticks = timer_ticks ();
+  ring = (struct schedtrace_record *) ((struct schedtrace_header *) buffer + 1);
+}
+
+/* Records EVENT for thread T.  May be called from any context. */
+void
+schedtrace_record (enum schedtrace_event event, const struct thread *t) 
+{
+  struct schedtrace_record *r;
+  enum intr_level old_level;
+
+  if (ring == NULL)
+    return;
+
+  old_level = spinlock_acquire (&ring_lock);
+  r = &ring[ring_head];
+  if (++ring_head == ring_size)
+    ring_head = 0;
+  record_cnt++;
+  r->tsc = rdtsc ();
+  r->tid = t->tid;
+  r->event = event;
+  r->priority = t->priority;
+  r->cpu = t->cpu->id;
+  spinlock_release (&ring_lock, old_level);
+}
+
+/* Reverses the records in R[FIRST] through R[LAST - 1]. */
+static void
+reverse (struct schedtrace_record *r, size_t first, size_t last) 
+{
+  while (first + 1 < last)
+    {
+      struct schedtrace_record tmp = r[first];
+      r[first++] = r[--last];
+      r[last] = tmp;
+    }
+}
+
+/* Stops tracing and appends the trace to the scratch device as
+   "schedtrace".  Called at shutdown. */
+void
+schedtrace_dump (void) 
+{
+  struct schedtrace_header *h = buffer;
+  struct schedtrace_record *r;
+  enum intr_level old_level;
+  int64_t ticks;
+  size_t cnt;
+
+  if (ring == NULL)
+    return;
+
+  /* Stop recording, then put the records in order: rotating the
+     ring left by RING_HEAD is three reversals. */
+  old_level = spinlock_acquire (&ring_lock);
+  r = ring;
+  ring = NULL;
+  spinlock_release (&ring_lock, old_level);
+  if (record_cnt > ring_size)
+    {
+      reverse (r, 0, ring_head);
+      reverse (r, ring_head, ring_size);
+      reverse (r, 0, ring_size);
+    }
+  cnt = record_cnt < ring_size ? record_cnt : ring_size;
+
+  memcpy (h->magic, "SCHEDTR", sizeof h->magic);
+  h->version = SCHEDTRACE_VERSION;
+  h->record_size = sizeof (struct schedtrace_record);
+  h->record_cnt = cnt;
+  h->dropped = record_cnt - cnt;
+  ticks = timer_elapsed (start_ticks);
+  h->tsc_hz = ticks > 0 ? (rdtsc () - start_tsc) / ticks * TIMER_FREQ : 0;
+
+#ifdef FILESYS
+  if (fsutil_append_buffer ("schedtrace", buffer,
+                            sizeof *h + cnt * sizeof *r))
+    printf ("schedtrace: %zu records written to scratch device\n", cnt);
+  else
+#endif
+    printf ("schedtrace: no scratch device, %zu records discarded\n", cnt);
+}
+#endif /* SCHEDTRACE */
@@ -0,0 +1,69 @@
+#ifndef THREADS_SCHEDTRACE_H
+#define THREADS_SCHEDTRACE_H
+
+#include <stdint.h>
+
+/* Scheduler event tracing.
+
+   Building with "make SCHEDTRACE=1" defines SCHEDTRACE.  The
+   scheduler then writes a compact record of each scheduling
+   event into a fixed-size ring buffer, keeping the most recent
+   SCHEDTRACE_PAGES worth.  At shutdown the buffer is appended to
+   the scratch device as a file named "schedtrace", which can be
+   fetched with "pintos -g schedtrace" and analyzed on the host
+   with utils/schedtrace.  Without the flag, schedtrace_record()
+   compiles to nothing. */
+
+/* Event types. */
+enum schedtrace_event
+  {
+    SCHED_RUN,                  /* Thread starts running. */
+    SCHED_BLOCK,                /* Running thread blocks. */
+    SCHED_UNBLOCK,              /* Blocked thread becomes ready. */
+    SCHED_YIELD,                /* Running thread becomes ready. */
+    SCHED_SLEEP,                /* Running thread goes to sleep. */
+    SCHED_EXIT,                 /* Running thread exits. */
+    SCHED_DONATE_BEGIN,         /* Thread starts donating to a lock. */
+    SCHED_DONATE_END,           /* Thread stops donating to a lock. */
+    SCHED_DONATE_PRIORITY       /* Thread's priority changed by donation. */
+  };
+
+/* One trace record, as stored in the buffer and on disk.  All
+   fields are little-endian. */
+struct schedtrace_record
+  {
+    uint64_t tsc;               /* Time stamp counter. */
+    int32_t tid;                /* Thread the event is about. */
+    uint8_t event;              /* enum schedtrace_event. */
+    uint8_t priority;           /* Thread's priority after the event. */
+    uint8_t cpu;                /* CPU the event happened on. */
+    uint8_t reserved;
+  };
+
+/* Header at the start of the dump.  Records follow, oldest
+   first. */
+struct schedtrace_header
+  {
+    char magic[8];              /* "SCHEDTR" plus a null. */
+    uint32_t version;           /* SCHEDTRACE_VERSION. */
+    uint32_t record_size;       /* sizeof (struct schedtrace_record). */
+    uint32_t record_cnt;        /* # of records that follow. */
+    uint32_t dropped;           /* # of older records overwritten. */
+    uint64_t tsc_hz;            /* Time stamp counter frequency. */
+  };
+
+#define SCHEDTRACE_VERSION 1
+
+#ifdef SCHEDTRACE
+struct thread;
+
+void schedtrace_init (void);
+void schedtrace_record (enum schedtrace_event, const struct thread *);
+void schedtrace_dump (void);
+#else
+#define schedtrace_init() ((void) 0)
+#define schedtrace_record(EVENT, THREAD) ((void) 0)
+#define schedtrace_dump() ((void) 0)
+#endif
+
+#endif /* threads/schedtrace.h */
@@ -0,0 +1,295 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches, after Bonwick's slab allocator.
+
+   Each slab is a single page from the page allocator.  It starts
+   with a struct slab, whose FREE array is a stack of the indexes
+   of the slab's free objects, followed by the objects themselves,
+   packed at the cache's object size.  Keeping the free list
+   outside the objects is what lets a free object keep its
+   constructed state.
+
+   A cache keeps the slabs that have both used and free objects
+   on its PARTIAL list and allocates from them first.  Full slabs
+   are on no list; a slab that becomes entirely free is kept as
+   the cache's one spare, or given back to the page allocator if
+   there already is one.  An object's slab is found by rounding
+   its address down to a page boundary, so freeing needs no
+   search. */
+
+/* A cache of objects of one size. */
+struct kmem_cache
+  {
+    const char *name;           /* For statistics. */
+    size_t size;                /* Size of each object in bytes. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t objs_ofs;            /* Offset of first object in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct lock lock;           /* Mutual exclusion. */
+    struct list partial;        /* Slabs with some objects free. */
+    struct slab *spare;         /* An entirely free slab, or null. */
+    struct list_elem elem;      /* Element in all_caches. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs allocated, including SPARE. */
+    size_t in_use;              /* Objects allocated. */
+    size_t max_in_use;          /* Most objects ever allocated. */
+    long long allocs;           /* Calls to kmem_cache_alloc(). */
+    long long frees;            /* Calls to kmem_cache_free(). */
+  };
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* A slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial list. */
+    size_t free_cnt;            /* Number of entries in FREE. */
+    uint16_t free[];            /* Indexes of free objects. */
+  };
+
+/* All caches, for kmem_print_stats(). */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *slab_create (struct kmem_cache *);
+static void *slab_object (struct kmem_cache *, struct slab *, size_t idx);
+static struct slab *object_to_slab (struct kmem_cache *, void *);
+
+/* Creates and returns a cache of objects of SIZE bytes named
+   NAME, which must remain valid for the life of the cache.  CTOR,
+   if non-null, constructs each object when its slab is created.
+   Returns a null pointer if memory is not available.  Must be
+   called after malloc_init(). */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+  size_t n;
+
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+
+  /* Fit as many objects as possible into a page, together with
+     the slab header and one free list entry per object. */
+  size = ROUND_UP (size, sizeof (void *));
+  n = (PGSIZE - sizeof (struct slab)) / (size + sizeof (uint16_t));
+  while (n > 0
+         && ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                      sizeof (void *)) + n * size > PGSIZE)
+    n--;
+  ASSERT (n > 0 && n <= UINT16_MAX);
+
+  c->name = name;
+  c->size = size;
+  c->objs_per_slab = n;
+  c->objs_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                          sizeof (void *));
+  c->ctor = ctor;
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  c->spare = NULL;
+  c->slab_cnt = c->in_use = c->max_in_use = 0;
+  c->allocs = c->frees = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &c->elem);
+  intr_set_level (old_level);
+  return c;
+}
+
+/* Allocates and returns an object from cache C, or returns a
+   null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (c != NULL);
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      /* Start on the spare slab, or a new one. */
+      s = c->spare;
+      c->spare = NULL;
+      if (s == NULL)
+        {
+          s = slab_create (c);
+          if (s == NULL)
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  obj = slab_object (c, s, s->free[--s->free_cnt]);
+  if (s->free_cnt == 0)
+    list_remove (&s->elem);
+  c->allocs++;
+  if (++c->in_use > c->max_in_use)
+    c->max_in_use = c->in_use;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Frees OBJ, which must have been allocated from cache C.  If C
+   has a constructor, OBJ must be in its constructed state.  Does
+   nothing if OBJ is a null pointer. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  bool was_full;
+
+  ASSERT (c != NULL);
+  if (obj == NULL)
+    return;
+
+  s = object_to_slab (c, obj);
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has to stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  was_full = s->free_cnt == 0;
+  s->free[s->free_cnt++] = ((uint8_t *) obj - (uint8_t *) s - c->objs_ofs)
+                           / c->size;
+  if (s->free_cnt == c->objs_per_slab)
+    {
+      /* The slab is entirely free. */
+      if (!was_full)
+        list_remove (&s->elem);
+      if (c->spare == NULL)
+        c->spare = s;
+      else
+        {
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+    }
+  else if (was_full)
+    list_push_front (&c->partial, &s->elem);
+  c->frees++;
+  c->in_use--;
+  lock_release (&c->lock);
+}
+
+/* Destroys cache C, all of whose objects must have been freed. */
+void
+kmem_cache_destroy (struct kmem_cache *c)
+{
+  enum intr_level old_level;
+
+  if (c == NULL)
+    return;
+
+  ASSERT (c->in_use == 0);
+  ASSERT (list_empty (&c->partial));
+
+  old_level = intr_disable ();
+  list_remove (&c->elem);
+  intr_set_level (old_level);
+
+  if (c->spare != NULL)
+    palloc_free_page (c->spare);
+  free (c);
+}
+
+/* Prints object cache statistics. */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+
+      printf ("Kmem cache %s: %zu-byte objects, %zu per slab, "
+              "%zu in use (%zu max), %zu slabs, %lld allocs, %lld frees\n",
+              c->name, c->size, c->objs_per_slab, c->in_use, c->max_in_use,
+              c->slab_cnt, c->allocs, c->frees);
+    }
+}
+
+/* Allocates a slab for cache C, constructs its objects if C has
+   a constructor, and returns it with every object free.  Returns
+   a null pointer if no page is available. */
+static struct slab *
+slab_create (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+
+  /* Hand out the lowest-addressed objects first. */
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      s->free[i] = c->objs_per_slab - 1 - i;
+      if (c->ctor != NULL)
+        c->ctor (slab_object (c, s, i));
+    }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the IDX'th object in slab S of cache C. */
+static void *
+slab_object (struct kmem_cache *c, struct slab *s, size_t idx)
+{
+  ASSERT (idx < c->objs_per_slab);
+  return (uint8_t *) s + c->objs_ofs + idx * c->size;
+}
+
+/* Returns the slab that OBJ, an object of cache C, is inside. */
+static struct slab *
+object_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= c->objs_ofs);
+  ASSERT ((pg_ofs (obj) - c->objs_ofs) % c->size == 0);
+
+  return s;
+}
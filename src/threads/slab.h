@@ -0,0 +1,31 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object caches.
+
+   A cache hands out objects of a single, fixed size, carved out
+   of page-size "slabs" with no per-object rounding beyond
+   pointer alignment, so it suits structures that are allocated
+   often and whose sizes fall badly for malloc()'s powers of 2.
+
+   If a constructor is given, it is run on each object once, when
+   the slab holding it is created, and not again: an object
+   freed back to its cache must be left in its constructed state,
+   which is then what the next kmem_cache_alloc() returns.
+   Without a constructor, the contents of a newly allocated
+   object are undefined, as with malloc(). */
+
+struct kmem_cache;
+typedef void kmem_ctor_func (void *);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_destroy (struct kmem_cache *);
+
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
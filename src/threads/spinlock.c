@@ -0,0 +1,113 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include "threads/cpu.h"
+
+#ifdef SMP
+/* Atomically stores NEW into *P and returns the old value.  The
+   `xchg' instruction with a memory operand is always locked.
+   See [IA32-v2b] "XCHG". */
+static inline uint32_t
+xchg (volatile uint32_t *p, uint32_t new)
+{
+  asm volatile ("xchgl %0, %1" : "+m" (*p), "+r" (new) : : "memory");
+  return new;
+}
+#endif
+
+/* Initializes LOCK as an unheld spin lock. */
+void
+spinlock_init (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  lock->locked = 0;
+  lock->cpu = NULL;
+}
+
+/* Turns interrupts off and acquires LOCK, spinning until it is
+   available.  Returns the previous interrupt level, to be passed
+   to spinlock_release(). */
+enum intr_level
+spinlock_acquire (struct spinlock *lock)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (!spinlock_held (lock));
+
+  old_level = intr_disable ();
+#ifdef SMP
+  while (xchg (&lock->locked, 1) != 0)
+    {
+      /* Spin on a plain read, so that waiting CPUs don't keep
+         taking the cache line away from the holder.  `pause'
+         tells the CPU that this is a spin-wait loop.  See
+         [IA32-v2b] "PAUSE". */
+      while (lock->locked)
+        asm volatile ("pause" : : : "memory");
+    }
+  lock->cpu = cpu_current ();
+#else
+  lock->locked = 1;
+#endif
+  return old_level;
+}
+
+/* Tries to acquire LOCK without spinning.  If successful, turns
+   interrupts off, stores the previous interrupt level into
+   *OLD_LEVEL and returns true; otherwise returns false with the
+   interrupt level unchanged. */
+bool
+spinlock_try_acquire (struct spinlock *lock, enum intr_level *old_level)
+{
+  ASSERT (lock != NULL);
+  ASSERT (old_level != NULL);
+
+  *old_level = intr_disable ();
+#ifdef SMP
+  if (xchg (&lock->locked, 1) != 0)
+    {
+      intr_set_level (*old_level);
+      return false;
+    }
+  lock->cpu = cpu_current ();
+#else
+  if (lock->locked)
+    {
+      intr_set_level (*old_level);
+      return false;
+    }
+  lock->locked = 1;
+#endif
+  return true;
+}
+
+/* Releases LOCK, which must be held by the current CPU, and
+   restores the interrupt level OLD_LEVEL returned when it was
+   acquired. */
+void
+spinlock_release (struct spinlock *lock, enum intr_level old_level)
+{
+  ASSERT (spinlock_held (lock));
+
+#ifdef SMP
+  lock->cpu = NULL;
+  xchg (&lock->locked, 0);
+#else
+  lock->locked = 0;
+#endif
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current CPU holds LOCK, false otherwise. */
+bool
+spinlock_held (const struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+#ifdef SMP
+  return lock->locked && lock->cpu == cpu_current ();
+#else
+  return lock->locked;
+#endif
+}
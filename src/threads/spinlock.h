@@ -0,0 +1,38 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* Spin lock.
+
+   Protects data shared between CPUs over short critical
+   sections that never sleep.  Acquiring a spin lock also turns
+   interrupts off on the acquiring CPU, so the same lock may be
+   taken from thread and interrupt context, and the previous
+   interrupt level is handed back to spinlock_release():
+
+      enum intr_level old_level = spinlock_acquire (&lock);
+      ...
+      spinlock_release (&lock, old_level);
+
+   Spin locks are not recursive.
+
+   Only the bootstrap processor runs for now (see cpu.c), so
+   turning interrupts off is all the mutual exclusion that is
+   needed, and unless SMP is defined a spin lock does nothing
+   else. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* Nonzero while held. */
+    struct cpu *cpu;            /* CPU holding it (for debugging). */
+  };
+
+void spinlock_init (struct spinlock *);
+enum intr_level spinlock_acquire (struct spinlock *);
+bool spinlock_try_acquire (struct spinlock *, enum intr_level *);
+void spinlock_release (struct spinlock *, enum intr_level);
+bool spinlock_held (const struct spinlock *);
+
+#endif /* threads/spinlock.h */
@@ -31,6 +31,53 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef LOCKSTAT
+#include "devices/timer.h"
+#endif
+
+#ifdef LOCKSTAT
+/* Lock contention statistics.
+
+   Semaphores, and so locks, are grouped into classes by the code
+   that initialized them, so that every lock set up by one call to
+   lock_init() -- a global like file_lock, or a lock embedded in
+   each instance of some structure -- adds up into one entry.
+   Semaphores whose initialization site doesn't fit in the table
+   share the OVERFLOW entry. */
+#define LOCKSTAT_CLASSES 64
+
+struct lockstat
+  {
+    void *init_site;            /* Where the semaphore was initialized. */
+    long long acquired;         /* Number of downs or acquisitions. */
+    long long contended;        /* Number of those that had to wait. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+    int64_t max_wait;           /* Longest single wait. */
+    void *max_wait_site;        /* Caller that waited longest. */
+    int64_t max_hold;           /* Longest a lock was held, in ticks. */
+  };
+
+static struct lockstat lockstats[LOCKSTAT_CLASSES];
+static struct lockstat lockstat_overflow;
+
+static struct lockstat *lockstat_lookup (void *site);
+static void lockstat_account (struct lockstat *, int64_t wait, void *site);
+static void lockstat_hold (struct lock *);
+#endif
+
+static void sema_init_at (struct semaphore *, unsigned value, void *site);
+static void sema_down_at (struct semaphore *, void *site);
+
+/* Lab1 - priority scheduling */
+/* Waiters are kept in heaps keyed on their effective priority,
+   and in order of arrival among equal priorities.  WAIT_SEQ
+   numbers arrivals. */
+static unsigned wait_seq;
+static heap_less_func sema_waiter_less;
+static heap_less_func cond_waiter_less;
+static heap_less_func lock_donor_less;
+static void sema_refresh_waiters (struct semaphore *);
+static void cond_refresh_waiters (struct condition *);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -43,11 +90,21 @@
      thread, if any). */
 void
 sema_init (struct semaphore *sema, unsigned value) 
+{
+  sema_init_at (sema, value, __builtin_return_address (0));
+}
+
+/* Initializes SEMA to VALUE on behalf of the code at SITE. */
+static void
+sema_init_at (struct semaphore *sema, unsigned value, void *site UNUSED)
 {
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, sema_waiter_less, NULL);
+#ifdef LOCKSTAT
+  sema->stat = lockstat_lookup (site);
+#endif
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -59,6 +116,13 @@ sema_init (struct semaphore *sema, unsigned value)
    thread will probably turn interrupts back on. */
 void
 sema_down (struct semaphore *sema) 
+{
+  sema_down_at (sema, __builtin_return_address (0));
+}
+
+/* Downs SEMA on behalf of the code at SITE. */
+static void
+sema_down_at (struct semaphore *sema, void *site UNUSED)
 {
   enum intr_level old_level;
 
@@ -66,15 +130,26 @@ sema_down (struct semaphore *sema)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+#ifdef LOCKSTAT
+  int64_t start = sema->value == 0 ? timer_ticks () : -1;
+#endif
+  if (sema->value == 0)
+    thread_current () -> wait_seq = wait_seq++;
   while (sema->value == 0) 
     {
       // list_push_back (&sema->waiters, &thread_current ()->elem);
 
       /* Lab1 - priority scheduling */
-      list_insert_ordered (&sema -> waiters, &thread_current () -> elem, thread_compare_priority, 0);
+      struct thread *current = thread_current ();
+      current -> wait_sema = sema;
+      heap_push (&sema -> waiters, &current -> wait_elem);
       thread_block ();
     }
   sema->value--;
+#ifdef LOCKSTAT
+  lockstat_account (sema->stat, start < 0 ? -1 : timer_ticks () - start,
+                    site);
+#endif
   intr_set_level (old_level);
 }
 
@@ -116,16 +191,19 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) 
+  if (!heap_empty (&sema->waiters)) 
   {
     /* Lab1 - priority scheduling */
-    /* Priority of waiters for a sema can be changed.
-       Validate with sorting the waiter list.  
-       Waiters list here is list of *THREADS*.       */
-    list_sort (&sema -> waiters, thread_compare_priority, 0);
-
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    /* Waiters are re-keyed whenever donation changes their
+       priority, so the top of the heap is the one to wake. */
+    /* Lab1 - MLFQS */
+    /* Blocked threads decay lazily; bring them up to date first. */
+    if (thread_mlfqs)
+      sema_refresh_waiters (sema);
+
+    struct thread *t = heap_entry (heap_pop (&sema -> waiters), struct thread, wait_elem);
+    t -> wait_sema = NULL;
+    thread_unblock (t);
   }
   sema->value++;
 
@@ -160,12 +238,106 @@ sema_self_test (void)
 }
 
 /* Lab1 - priority scheduling */
-bool
-sema_compare_priority (const struct list_elem *p1, const struct list_elem *p2, void *aux UNUSED)
+/* Orders threads waiting on a semaphore: higher priority first,
+   then first come, first served. */
+static bool
+sema_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_, void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+  const struct thread *b = heap_entry (b_, struct thread, wait_elem);
+
+  if (a -> priority != b -> priority)
+    return a -> priority < b -> priority;
+  return (int) (a -> wait_seq - b -> wait_seq) > 0;
+}
+
+/* Lab1 - priority scheduling */
+/* Orders threads waiting on a condition, the same way. */
+static bool
+cond_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_, void *aux UNUSED)
+{
+  const struct semaphore_elem *a = heap_entry (a_, struct semaphore_elem, elem);
+  const struct semaphore_elem *b = heap_entry (b_, struct semaphore_elem, elem);
+
+  if (a -> thread -> priority != b -> thread -> priority)
+    return a -> thread -> priority < b -> thread -> priority;
+  return (int) (a -> seq - b -> seq) > 0;
+}
+
+/* Lab1 - priority donation */
+/* Orders threads donating through a lock by priority. */
+static bool
+lock_donor_less (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
+{
+  return (heap_entry (a, struct thread, donation_elem) -> priority
+          < heap_entry (b, struct thread, donation_elem) -> priority);
+}
+
+/* Lab1 - priority scheduling */
+/* Restores T's place among the waiters of the semaphore or
+   condition it is waiting on, after its priority has changed.
+   Must be called with interrupts off. */
+void
+sema_waiter_update (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t -> wait_sema != NULL)
+    heap_update (&t -> wait_sema -> waiters, &t -> wait_elem);
+  if (t -> wait_cond != NULL)
+    heap_update (&t -> wait_cond -> waiters, &t -> cond_waiter -> elem);
+}
+
+/* Lab1 - MLFQS */
+/* Brings the priorities of SEMA's waiters up to date.  Refreshing
+   a waiter may re-key it, so the waiters are taken out of the
+   heap while that happens.  Must be called with interrupts off. */
+static void
+sema_refresh_waiters (struct semaphore *sema)
+{
+  struct list refresh;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_init (&refresh);
+  while (!heap_empty (&sema -> waiters))
+  {
+    struct thread *t = heap_entry (heap_pop (&sema -> waiters), struct thread, wait_elem);
+    t -> wait_sema = NULL;
+    list_push_back (&refresh, &t -> elem);
+  }
+  while (!list_empty (&refresh))
+  {
+    struct thread *t = list_entry (list_pop_front (&refresh), struct thread, elem);
+    mlfqs_refresh (t);
+    t -> wait_sema = sema;
+    heap_push (&sema -> waiters, &t -> wait_elem);
+  }
+}
+
+/* Lab1 - MLFQS */
+/* Same as sema_refresh_waiters(), for COND. */
+static void
+cond_refresh_waiters (struct condition *cond)
 {
-  struct list *waiter1 = &(list_entry (p1, struct semaphore_elem, elem) -> semaphore.waiters);
-  struct list *waiter2 = &(list_entry (p2, struct semaphore_elem, elem) -> semaphore.waiters);
-  return list_entry (list_begin (waiter1), struct thread, elem) -> priority > list_entry (list_begin (waiter2), struct thread, elem) -> priority;
+  struct list refresh;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_init (&refresh);
+  while (!heap_empty (&cond -> waiters))
+  {
+    struct semaphore_elem *w = heap_entry (heap_pop (&cond -> waiters), struct semaphore_elem, elem);
+    w -> thread -> wait_cond = NULL;
+    list_push_back (&refresh, &w -> thread -> elem);
+  }
+  while (!list_empty (&refresh))
+  {
+    struct thread *t = list_entry (list_pop_front (&refresh), struct thread, elem);
+    mlfqs_refresh (t);
+    t -> wait_cond = cond;
+    heap_push (&cond -> waiters, &t -> cond_waiter -> elem);
+  }
 }
 
 /* Thread function used by sema_self_test(). */
@@ -203,7 +375,11 @@ lock_init (struct lock *lock)
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
-  sema_init (&lock->semaphore, 1);
+  sema_init_at (&lock->semaphore, 1, __builtin_return_address (0));
+
+  /* Lab1 - priority donation */
+  heap_init (&lock->donors, lock_donor_less, NULL);
+  lock->priority = PRI_MIN;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -222,21 +398,29 @@ lock_acquire (struct lock *lock)
   ASSERT (!lock_held_by_current_thread (lock));
 
   struct thread *current = thread_current ();
+  enum intr_level old_level;
 
   /* Lab1 - priority donation & MLFQS */
   if (!thread_mlfqs && lock -> holder)
-  {
-    current -> _lock = lock;
-    list_insert_ordered (&lock -> holder -> donation_list, &current -> donation_elem, thread_compare_donation_priority, 0);
-    donate_priority ();
-  }
+    donate_priority (lock);
 
-  sema_down (&lock->semaphore);
+  sema_down_at (&lock->semaphore, __builtin_return_address (0));
 
   /* Lab1 - priority donation */
-  current -> _lock = NULL;
-  
-  lock->holder = thread_current ();
+  /* Threads still waiting for LOCK donate to us from now on. */
+  if (current -> _lock != NULL)
+    withdraw_donation ();
+
+  /* A donor that sees HOLDER set updates LOCK's place among the
+     holder's locks, so LOCK must be among them by then. */
+  old_level = intr_disable ();
+  lock->holder = current;
+  if (!thread_mlfqs)
+    add_donation (lock);
+  intr_set_level (old_level);
+#ifdef LOCKSTAT
+  lock->acquired = timer_ticks ();
+#endif
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -249,13 +433,27 @@ bool
 lock_try_acquire (struct lock *lock)
 {
   bool success;
+  enum intr_level old_level;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      old_level = intr_disable ();
+      lock->holder = thread_current ();
+
+      /* Lab1 - priority donation */
+      if (!thread_mlfqs)
+        add_donation (lock);
+      intr_set_level (old_level);
+#ifdef LOCKSTAT
+      lock->acquired = timer_ticks ();
+      lockstat_account (lock->semaphore.stat, -1,
+                        __builtin_return_address (0));
+#endif
+    }
   return success;
 }
 
@@ -267,24 +465,29 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+#ifdef LOCKSTAT
+  lockstat_hold (lock);
+#endif
+
+  /* LOCK leaves the holder's locks and loses its holder at once,
+     as seen by donors, as in lock_acquire(). */
+  old_level = intr_disable ();
+
   /* Lab1 - MLFQS */
   if (!thread_mlfqs)
   {
     /* Lab1 - priority scheduling */
+    /* Threads waiting for LOCK stay among its donors and donate
+       to whoever acquires it next. */
     remove_donation (lock);
-    /* update_donation() for only current thread
-      :: Only donations made by currently releasing lock
-      will make changes. Other priority donations
-      DOES NOT change the other threads' priority.  */
-    /* Operation of set priority function can mess up donations.
-      re-order the donation list to clear up donations. */
-    update_donation ();
   }
-
   lock->holder = NULL;
+  intr_set_level (old_level);
   sema_up (&lock->semaphore);
 }
 
@@ -307,7 +510,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  heap_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -344,9 +547,17 @@ cond_wait (struct condition *cond, struct lock *lock)
   // list_push_back (&cond->waiters, &waiter.elem);
 
   /* Lab1 - priority scheduling */
-  /* Waiters are a list of semaphores. Use compare function for semaphores
-     ordering semaphores according the highest priority of it.   */
-  list_insert_ordered (&cond -> waiters, &waiter.elem, sema_compare_priority, 0);
+  /* Waiters are a heap of semaphores, keyed on the priority of
+     the thread waiting on each.  Donation can re-key it from
+     another thread, so it is only touched with interrupts off. */
+  struct thread *current = thread_current ();
+  enum intr_level old_level = intr_disable ();
+  waiter.thread = current;
+  waiter.seq = wait_seq++;
+  current -> wait_cond = cond;
+  current -> cond_waiter = &waiter;
+  heap_push (&cond -> waiters, &waiter.elem);
+  intr_set_level (old_level);
   
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -368,18 +579,27 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
+  enum intr_level old_level = intr_disable ();
+  if (!heap_empty (&cond->waiters)) 
   {
     /* Lab1 - priority scheduling */
-    /* Priority of waiters can be changed. */
-    list_sort (&cond -> waiters, sema_compare_priority, 0);
+    /* Waiters are re-keyed whenever donation changes their
+       priority, so the top of the heap is the one to signal. */
+    /* Lab1 - MLFQS */
+    /* Blocked threads decay lazily; bring them up to date first. */
+    if (thread_mlfqs)
+      cond_refresh_waiters (cond);
+
+    struct semaphore_elem *waiter = heap_entry (heap_pop (&cond -> waiters), struct semaphore_elem, elem);
+    waiter -> thread -> wait_cond = NULL;
+    waiter -> thread -> cond_waiter = NULL;
 
     /* Unblocking a thread by sema_up() function may have
        higher priority thread on ready_list. sema_up() function
        will handle it. */
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    sema_up (&waiter -> semaphore);
   }
+  intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -394,6 +614,361 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!heap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as a reader-writer lock.  Any number of readers
+   may hold a reader-writer lock at once, or a single writer.
+
+   Our reader-writer locks prefer writers: once a writer is
+   waiting, new readers wait until no writer is waiting or
+   writing, so that a steady stream of readers can't starve
+   writers out.  Threads that wait for a writer donate their
+   priority to it, just like threads waiting for a lock.  Readers
+   don't receive donations.
+
+   A thread may hold at most one reader-writer lock for reading
+   at a time. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->writer);
+  rw->readers = 0;
+  rw->waiting_writers = 0;
+  rw->draining = false;
+  sema_init (&rw->drained, 0);
+  list_init (&rw->waiters);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or is
+   waiting for it.  RW must not already be held by the current
+   thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  struct thread *current = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (current -> rwlock_reading == NULL);
+  ASSERT (!lock_held_by_current_thread (&rw->writer));
+
+  old_level = intr_disable ();
+  while (rw->writer.holder != NULL || rw->waiting_writers > 0)
+    {
+      /* Lab1 - priority donation */
+      /* Donate to the writer, as if waiting for its lock, until
+         we are woken up. */
+      if (!thread_mlfqs && rw->writer.holder != NULL)
+        donate_priority (&rw->writer);
+      list_push_back (&rw->waiters, &current -> elem);
+      thread_block ();
+      if (current -> _lock != NULL)
+        withdraw_donation ();
+    }
+  rw->readers++;
+  current -> rwlock_reading = rw;
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  struct thread *current = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (current -> rwlock_reading == rw);
+
+  old_level = intr_disable ();
+  current -> rwlock_reading = NULL;
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0 && rw->draining)
+    {
+      rw->draining = false;
+      sema_up (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other writer holds
+   it and all readers have left.  RW must not already be held by
+   the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (thread_current () -> rwlock_reading != rw);
+
+  /* Keep new readers out while we wait for the current writer. */
+  old_level = intr_disable ();
+  rw->waiting_writers++;
+  intr_set_level (old_level);
+
+  lock_acquire (&rw->writer);
+
+  /* Holding WRITER keeps new readers out; wait for the ones
+     already in. */
+  old_level = intr_disable ();
+  rw->waiting_writers--;
+  if (rw->readers > 0)
+    {
+      rw->draining = true;
+      sema_down (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing,
+   and lets waiting readers in unless another writer is waiting. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (lock_held_by_current_thread (&rw->writer));
+
+  old_level = intr_disable ();
+  lock_release (&rw->writer);
+  if (rw->waiting_writers == 0 && !list_empty (&rw->waiters))
+    {
+      while (!list_empty (&rw->waiters))
+        thread_unblock (list_entry (list_pop_front (&rw->waiters),
+                                    struct thread, elem));
+
+      /* Lab1 - priority scheduling */
+      thread_validate_priority ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds RW for reading or for
+   writing, false otherwise. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return (lock_held_by_current_thread (&rw->writer)
+          || thread_current () -> rwlock_reading == rw);
+}
+
+/* Initializes SL as a sequence lock.  A sequence lock protects
+   small, read-mostly data without making readers wait for each
+   other or write to shared memory.  Writers are serialized by a
+   lock and bump the sequence count before and after each write;
+   a reader copies the data out between seqlock_read_begin() and
+   seqlock_read_retry() and starts over if the count moved:
+
+      do
+        {
+          start = seqlock_read_begin (&sl);
+          ...copy data...
+        }
+      while (seqlock_read_retry (&sl, start));
+
+   Readers must not follow pointers in the data they copy, since
+   a concurrent write may leave them dangling.  If the data is
+   read from interrupt handlers, writers must disable interrupts
+   around the write, since an interrupted write can't complete
+   until the handler returns. */
+void
+seqlock_init (struct seqlock *sl)
+{
+  ASSERT (sl != NULL);
+
+  sl->sequence = 0;
+  lock_init (&sl->lock);
+}
+
+/* Starts a read of data protected by SL, returning the sequence
+   count to pass to seqlock_read_retry().  If a write is in
+   progress, waits for it to finish, donating priority to the
+   writer. */
+unsigned
+seqlock_read_begin (struct seqlock *sl)
+{
+  unsigned start;
+
+  ASSERT (sl != NULL);
+
+  for (;;)
+    {
+      start = sl->sequence;
+      barrier ();
+      if ((start & 1) == 0)
+        return start;
+
+      /* Wait for the writer by passing through its lock. */
+      ASSERT (!intr_context ());
+      lock_acquire (&sl->lock);
+      lock_release (&sl->lock);
+    }
+}
+
+/* Returns true if data protected by SL may have changed since
+   the seqlock_read_begin() that returned START, in which case the
+   read must be retried. */
+bool
+seqlock_read_retry (const struct seqlock *sl, unsigned start)
+{
+  ASSERT (sl != NULL);
+
+  barrier ();
+  return sl->sequence != start;
+}
+
+/* Starts a write of data protected by SL, sleeping until other
+   writers are done.  Must not be called within an interrupt
+   handler. */
+void
+seqlock_write_begin (struct seqlock *sl)
+{
+  ASSERT (sl != NULL);
+
+  lock_acquire (&sl->lock);
+  sl->sequence++;
+  barrier ();
+}
+
+/* Finishes a write of data protected by SL. */
+void
+seqlock_write_end (struct seqlock *sl)
+{
+  ASSERT (sl != NULL);
+  ASSERT (lock_held_by_current_thread (&sl->lock));
+
+  barrier ();
+  sl->sequence++;
+  lock_release (&sl->lock);
+}
+
+#ifdef LOCKSTAT
+/* Returns the statistics entry for semaphores initialized at
+   SITE, claiming a free one if there is none yet. */
+static struct lockstat *
+lockstat_lookup (void *site)
+{
+  struct lockstat *stat = &lockstat_overflow;
+  enum intr_level old_level;
+  size_t i, probe;
+
+  old_level = intr_disable ();
+  i = ((uintptr_t) site >> 2) % LOCKSTAT_CLASSES;
+  for (probe = 0; probe < LOCKSTAT_CLASSES; probe++)
+    {
+      struct lockstat *s = &lockstats[(i + probe) % LOCKSTAT_CLASSES];
+      if (s->init_site == site || s->init_site == NULL)
+        {
+          s->init_site = site;
+          stat = s;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+
+  return stat;
+}
+
+/* Records a down of a semaphore in STAT by the code at SITE,
+   after waiting WAIT ticks, or without waiting at all if WAIT is
+   negative.  Must be called with interrupts off or from a context
+   that can't be preempted. */
+static void
+lockstat_account (struct lockstat *stat, int64_t wait, void *site)
+{
+  if (stat == NULL)
+    return;
+
+  stat->acquired++;
+  if (wait >= 0)
+    {
+      stat->contended++;
+      stat->wait_ticks += wait;
+      if (stat->max_wait_site == NULL || wait > stat->max_wait)
+        {
+          stat->max_wait = wait;
+          stat->max_wait_site = site;
+        }
+    }
+}
+
+/* Records how long LOCK, about to be released, was held. */
+static void
+lockstat_hold (struct lock *lock)
+{
+  struct lockstat *stat = lock->semaphore.stat;
+  int64_t held;
+
+  if (stat == NULL)
+    return;
+
+  held = timer_ticks () - lock->acquired;
+  if (held > stat->max_hold)
+    stat->max_hold = held;
+}
+
+/* Prints lock contention statistics for every class of semaphore
+   that was ever downed, most total waiting first.  Addresses can
+   be turned into source locations with the "backtrace" tool. */
+void
+lockstat_print_stats (void)
+{
+  struct lockstat *sorted[LOCKSTAT_CLASSES + 1];
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i <= LOCKSTAT_CLASSES; i++)
+    {
+      struct lockstat *stat = i < LOCKSTAT_CLASSES ? &lockstats[i]
+                                                   : &lockstat_overflow;
+      size_t j;
+
+      if (stat->acquired == 0)
+        continue;
+
+      /* Insertion sort by total wait, then by contended count. */
+      for (j = cnt; j > 0; j--)
+        {
+          struct lockstat *prev = sorted[j - 1];
+          if (prev->wait_ticks > stat->wait_ticks
+              || (prev->wait_ticks == stat->wait_ticks
+                  && prev->contended >= stat->contended))
+            break;
+          sorted[j] = prev;
+        }
+      sorted[j] = stat;
+      cnt++;
+    }
+
+  printf ("Lockstat: %zu lock classes, by total wait:\n", cnt);
+  for (i = 0; i < cnt; i++)
+    {
+      struct lockstat *stat = sorted[i];
+
+      printf ("  %p: %lld acquired, %lld contended, %lld wait ticks, "
+              "%lld max hold ticks",
+              stat->init_site, stat->acquired, stat->contended,
+              stat->wait_ticks, stat->max_hold);
+      if (stat->max_wait_site != NULL)
+        printf (", longest wait %lld ticks at %p",
+                stat->max_wait, stat->max_wait_site);
+      printf ("\n");
+    }
+}
+#endif
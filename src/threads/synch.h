@@ -1,14 +1,25 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+#ifdef LOCKSTAT
+struct lockstat;
+#endif
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
+#ifdef LOCKSTAT
+    struct lockstat *stat;      /* Contention statistics. */
+#endif
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -18,13 +29,21 @@ void sema_up (struct semaphore *);
 void sema_self_test (void);
 
 /* Lab1 - priority scheduling */
-bool sema_compare_priority (const struct list_elem *p1, const struct list_elem *p2, void *aux);
+void sema_waiter_update (struct thread *);
 
 /* Lock. */
 struct lock 
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+
+    /* Lab1 - priority donation */
+    struct heap donors;         /* Threads donating to HOLDER, by priority. */
+    struct heap_elem elem;      /* Element in HOLDER's held locks. */
+    int priority;               /* Highest priority among DONORS. */
+#ifdef LOCKSTAT
+    int64_t acquired;           /* Tick at which HOLDER acquired it. */
+#endif
   };
 
 void lock_init (struct lock *);
@@ -36,14 +55,16 @@ bool lock_held_by_current_thread (const struct lock *);
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
-/* One semaphore in a list. */
+/* One semaphore in a condition's waiters. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
+    unsigned seq;                       /* Arrival order. */
   };
 
 void cond_init (struct condition *);
@@ -51,6 +72,41 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader-writer lock. */
+struct rwlock
+  {
+    struct lock writer;         /* Held by the writer, if any. */
+    unsigned readers;           /* Number of active readers. */
+    unsigned waiting_writers;   /* Writers waiting for WRITER. */
+    bool draining;              /* Writer waiting for readers to leave? */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+    struct list waiters;        /* Readers waiting for writers. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
+/* Sequence lock. */
+struct seqlock
+  {
+    unsigned sequence;          /* Odd while a write is in progress. */
+    struct lock lock;           /* Serializes writers. */
+  };
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (struct seqlock *);
+bool seqlock_read_retry (const struct seqlock *, unsigned start);
+void seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *);
+
+#ifdef LOCKSTAT
+void lockstat_print_stats (void);
+#endif
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -4,10 +4,13 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/schedtrace.h"
+#include "threads/slab.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -31,28 +34,40 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* List of process in THREAD_SLEEP state, that is, processes
-   that are sleeping till the wake_tick of each and wake up
-   after wake_tick. */
-static struct list sleep_list;
-
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
+/* Thread page cache.
+
+   A thread's page, along with its pcb page, is referenced by the
+   thread itself until it has been switched away from for the
+   last time, and by its parent for as long as it is on the
+   parent's child_list, that is, until the parent waits for it or
+   exits, or, for kernel threads nobody waits for, until it dies.  Once
+   both references are gone the page goes onto thread_cache, from
+   which thread_create() takes pages before going to the page
+   allocator.  Dying threads are switched away from with
+   interrupts off, where palloc_free_page() can't be called, so
+   pages beyond THREAD_CACHE_MAX are only given back to the page
+   allocator by the next thread_create(). */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;         /* # of pages in thread_cache. */
+static long long thread_cache_hits;     /* # of creates from the cache. */
+static long long thread_cache_misses;   /* # of creates from palloc. */
+static long long thread_pages;          /* # of thread pages allocated. */
+
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* lab3 - MMF */
+/* Cache of `struct mmf's, created by thread_start(). */
+static struct kmem_cache *mmf_cache;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -78,7 +93,26 @@ bool thread_mlfqs;
 /* Lab1 - MLFQS */
 int load_avg;
 
+/* Lab1 - MLFQS */
+/* recent_cpu decays lazily.  Every second starts a new decay
+   epoch, whose coefficient 2*load_avg / (2*load_avg + 1) is kept
+   in mlfqs_decay.  Running and ready threads are decayed right
+   away; a blocked thread catches up on the epochs it missed,
+   one coefficient at a time so that the result is exactly what
+   a per-second sweep would give, when it is unblocked or its
+   priority is looked at.  Every FP_DECAY_EPOCHS seconds, before
+   the table wraps around, everyone is brought up to date. */
+static int mlfqs_epoch;
+static int mlfqs_decay[FP_DECAY_EPOCHS];
+
+/* Lab1 - MLFQS */
+/* Threads whose recent_cpu changed since their priority was last
+   computed.  Only these can get a new priority at the next
+   4-tick recomputation. */
+static struct list mlfqs_dirty_list;
+
 static void kernel_thread (thread_func *, void *aux);
+static alarm_func thread_wakeup;
 
 static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
@@ -89,13 +123,35 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *thread_cache_get (void);
+static void thread_cache_trim (void);
+static void thread_cache_put (struct thread *);
+static void thread_put (struct thread *);
+
+/* Lab1 - priority scheduling */
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (const struct run_queue *);
+static void run_queue_unlink (struct run_queue *, struct thread *);
+static bool is_idle_thread (const struct thread *);
+static void thread_set_effective_priority (struct thread *, int priority);
+
+/* Lab1 - priority donation */
+static heap_less_func held_lock_less;
+static void lock_update_priority (struct lock *);
+static void donation_propagate (struct thread *);
+
+/* Lab1 - MLFQS */
+static void mlfqs_mark_dirty (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the tid lock.  The run queues are part of
+   the per-CPU state set up by cpu_init(), which must be called
+   first.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -109,9 +165,9 @@ thread_init (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
-  list_init (&sleep_list);
   list_init (&all_list);
+  list_init (&mlfqs_dirty_list);
+  list_init (&thread_cache);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -133,22 +189,31 @@ thread_start (void)
   /* Lab1 - MLFQS */
   load_avg = LOAD_AVG_DEFAULT;
 
+  /* lab3 - MMF */
+  mmf_cache = kmem_cache_create ("mmf", sizeof (struct mmf), NULL);
+  if (mmf_cache == NULL)
+    PANIC ("could not create mmf cache");
+
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize our CPU's
+     idle_thread. */
   sema_down (&idle_started);
 }
 
 /* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+   Thus, this function usually runs in an external interrupt
+   context.  The exception is ticks that went by while the idle
+   thread had the periodic tick stopped, which may be accounted
+   for from the idle thread itself. */
 void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
 
   /* Update statistics. */
-  if (t == idle_thread)
+  if (is_idle_thread (t))
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
@@ -156,9 +221,10 @@ thread_tick (void)
 #endif
   else
     kernel_ticks++;
+  t->vm_ticks++;
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++thread_ticks >= TIME_SLICE && intr_context ())
     intr_yield_on_return ();
 }
 
@@ -168,6 +234,10 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread cache: %lld hits, %lld misses, %zu cached, "
+          "%lld live thread pages\n",
+          thread_cache_hits, thread_cache_misses, thread_cache_cnt,
+          thread_pages - (long long) thread_cache_cnt);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -193,14 +263,26 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  struct pcb *pcb;
+  void *fdtable;
   tid_t tid;
 
   ASSERT (function != NULL);
 
-  /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  /* Allocate thread, which comes with its pcb. */
+  thread_cache_trim ();
+  t = thread_cache_get ();
   if (t == NULL)
     return TID_ERROR;
+  pcb = t->pcb;
+
+  fdtable = palloc_get_page (PAL_ZERO);
+  if (fdtable == NULL)
+    {
+      /* Not initialized yet, so nothing references it. */
+      thread_cache_put (t);
+      return TID_ERROR;
+    }
 
   /* Initialize thread. */
   init_thread (t, name, priority);
@@ -226,35 +308,32 @@ thread_create (const char *name, int priority,
   struct thread *child = t;
 
   /* PCB */
-  struct pcb *pcb = child -> pcb = palloc_get_page (0);
+  child -> pcb = pcb;
 
-  if (pcb == NULL)
-    return TID_ERROR;
-  
   pcb -> exitcode = -1;
   pcb -> isexited = false;
   pcb -> isloaded = false;
+  pcb -> isprocess = false;
 
   sema_init (&(pcb -> load), 0);
   sema_init (&(pcb -> wait), 0);
 
   pcb -> _file = NULL;
 
-  pcb -> fdtable = palloc_get_page (PAL_ZERO);
+  pcb -> fdtable = fdtable;
   pcb -> fdcount = 2;
 
-  if (pcb -> fdtable == NULL)
-  {
-    palloc_free_page (pcb);
-    return TID_ERROR;
-  }
-
+  /* One reference for the child itself, one for its parent. */
+  child -> ref_cnt = 2;
   child -> parent = parent;
 
+  enum intr_level old_level = intr_disable ();
   list_push_back (&(parent -> child_list), &(child -> childelem));
+  intr_set_level (old_level);
 
   /* lab3 - supplemental page table */
   init_spt (&(t -> spt));
+  lock_init (&(t -> spt_lock));
 
   /* lab3 - MMF */
   list_init (&(t -> mmf_list));
@@ -284,6 +363,7 @@ thread_block (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   thread_current ()->status = THREAD_BLOCKED;
+  schedtrace_record (SCHED_BLOCK, thread_current ());
   schedule ();
 }
 
@@ -306,10 +386,15 @@ thread_unblock (struct thread *t)
   ASSERT (t->status == THREAD_BLOCKED);
   // list_push_back (&ready_list, &t->elem);
   
+  /* Lab1 - MLFQS */
+  if (thread_mlfqs)
+    mlfqs_refresh (t);
+
   /* Lab1 - priority scheduling */
-  list_insert_ordered (&ready_list, &t -> elem, thread_compare_priority, 0);
+  ready_queue_push (t);
   
   t->status = THREAD_READY;
+  schedtrace_record (SCHED_UNBLOCK, t);
   intr_set_level (old_level);
 }
 
@@ -362,7 +447,24 @@ thread_exit (void)
      when it calls thread_schedule_tail(). */
   intr_disable ();
   list_remove (&thread_current()->allelem);
+
+  /* Thread page cache */
+  /* No one can wait for our remaining children any more, and no
+     one waits for us unless we were started as a process. */
+  struct thread *cur = thread_current ();
+  while (!list_empty (&cur -> child_list))
+  {
+    struct thread *child = list_entry (list_front (&cur -> child_list), struct thread, childelem);
+    thread_release_child (child);
+  }
+  if (cur -> parent != NULL && !cur -> pcb -> isprocess)
+    thread_release_child (cur);
+
+  /* Lab1 - MLFQS */
+  if (thread_current ()->mlfqs_dirty)
+    list_remove (&thread_current ()->mlfqs_elem);
   thread_current ()->status = THREAD_DYING;
+  schedtrace_record (SCHED_EXIT, thread_current ());
   schedule ();
   NOT_REACHED ();
 }
@@ -378,12 +480,13 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread)
+  if (!is_idle_thread (cur))
   {
     // list_push_back (&ready_list, &cur->elem);
 
     /* Lab1 - priority scheduling */
-    list_insert_ordered (&ready_list, &cur -> elem, thread_compare_priority, 0);
+    ready_queue_push (cur);
+    schedtrace_record (SCHED_YIELD, cur);
   }
   cur->status = THREAD_READY;
   schedule ();
@@ -444,9 +547,7 @@ thread_set_nice (int nice UNUSED)
   thread -> nice = nice;
   mlfqs_update_priority (thread);
   
-  // Hotfix #1
-  list_sort (&ready_list, thread_compare_priority, 0);
-  if (thread != idle_thread) thread_validate_priority ();
+  if (!is_idle_thread (thread)) thread_validate_priority ();
   
   intr_set_level (old_level);
 }
@@ -486,18 +587,19 @@ thread_get_recent_cpu (void)
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
-   The idle thread is initially put on the ready list by
-   thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   Each CPU has its own idle thread.  It is initially put on the
+   ready list by thread_start().  It will be scheduled once
+   initially, at which point it initializes its CPU's
+   idle_thread, "up"s the semaphore passed to it to enable
+   thread_start() to continue, and immediately blocks.  After
+   that, the idle thread never appears in the ready list.  It is
+   returned by next_thread_to_run() as a special case when its
+   CPU's run queue is empty. */
 static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  cpu_current ()->idle_thread = thread_current ();
   sema_up (idle_started);
 
   for (;;) 
@@ -506,6 +608,11 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* With -nohz, stop the periodic tick until the next alarm
+         is due.  Interrupts are still off here, so no alarm can
+         be armed between computing the deadline and halting. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -554,6 +661,13 @@ is_thread (struct thread *t)
   return t != NULL && t->magic == THREAD_MAGIC;
 }
 
+/* Returns true if T is its CPU's idle thread. */
+static bool
+is_idle_thread (const struct thread *t)
+{
+  return t == t->cpu->idle_thread;
+}
+
 /* Does basic initialization of T as a blocked thread named
    NAME. */
 static void
@@ -571,19 +685,25 @@ init_thread (struct thread *t, const char *name, int priority)
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
   t->magic = THREAD_MAGIC;
+  t->cpu = cpu_current ();
 
   /* Lab1 - alarm clock */
-  t-> wakeup_ticks = -1;
+  alarm_init (&t -> sleep_alarm, thread_wakeup, t);
   /* Lab1 - priority donation */
   t -> priority_original = priority;
   t -> _lock = NULL;
-  list_init (&t -> donation_list);
+  heap_init (&t -> held_locks, held_lock_less, NULL);
   /* Lab1 - MLFQS */
   t -> nice = NICE_DEFAULT;
   t -> recent_cpu = RECENT_CPU_DEFAULT;
+  t -> mlfqs_epoch = mlfqs_epoch;
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
+  /* Lab1 - MLFQS */
+  /* The priority passed in is only a placeholder under the MLFQS. */
+  if (thread_mlfqs)
+    mlfqs_mark_dirty (t);
   intr_set_level (old_level);
 
   /* Lab2 - systemCall */
@@ -604,17 +724,120 @@ alloc_frame (struct thread *t, size_t size)
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   return a thread from this CPU's run queue, unless the run
+   queue is empty.  (If the running thread can continue running,
+   then it will be in the run queue.)  If the run queue is empty,
+   return this CPU's idle thread. */
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  struct cpu *c = cpu_current ();
+  struct run_queue *rq = &c->rq;
+  struct thread *t = NULL;
+  enum intr_level old_level;
+  int priority;
+
+  old_level = spinlock_acquire (&rq->lock);
+  priority = ready_queue_max_priority (rq);
+  if (priority >= PRI_MIN)
+    {
+      t = list_entry (list_front (&rq->queues[priority]), struct thread, elem);
+      run_queue_unlink (rq, t);
+    }
+  spinlock_release (&rq->lock, old_level);
+
+  return t != NULL ? t : c->idle_thread;
+}
+
+/* Lab1 - priority scheduling */
+/* Appends T to the run queue of its CPU for its priority. */
+static void
+ready_queue_push (struct thread *t)
+{
+  struct run_queue *rq = &t->cpu->rq;
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  old_level = spinlock_acquire (&rq->lock);
+  list_push_back (&rq->queues[t->priority], &t->elem);
+  rq->bitmap |= (uint64_t) 1 << t->priority;
+  rq->cnt++;
+  spinlock_release (&rq->lock, old_level);
+}
+
+/* Lab1 - priority scheduling */
+/* Removes T from its CPU's run queue for its priority. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  struct run_queue *rq = &t->cpu->rq;
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  old_level = spinlock_acquire (&rq->lock);
+  run_queue_unlink (rq, t);
+  spinlock_release (&rq->lock, old_level);
+}
+
+/* Lab1 - priority scheduling */
+/* Removes T from RQ, whose lock must be held. */
+static void
+run_queue_unlink (struct run_queue *rq, struct thread *t)
+{
+  ASSERT (spinlock_held (&rq->lock));
+
+  list_remove (&t->elem);
+  if (list_empty (&rq->queues[t->priority]))
+    rq->bitmap &= ~((uint64_t) 1 << t->priority);
+  rq->cnt--;
+}
+
+/* Lab1 - priority scheduling */
+/* Returns the highest priority among the threads in RQ, or
+   PRI_MIN - 1 if there are none. */
+static int
+ready_queue_max_priority (const struct run_queue *rq)
+{
+  uint32_t high = rq->bitmap >> 32;
+  uint32_t low = rq->bitmap;
+
+  if (high != 0)
+    return 63 - __builtin_clz (high);
+  else if (low != 0)
+    return 31 - __builtin_clz (low);
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return PRI_MIN - 1;
+}
+
+/* Lab1 - priority scheduling */
+/* Sets T's priority to PRIORITY.  If T is ready, it is moved to
+   the back of the run queue for its new priority; if it is
+   waiting on a semaphore or condition, its place among the
+   waiters is updated. */
+static void
+thread_set_effective_priority (struct thread *t, int priority)
+{
+  enum intr_level old_level;
+
+  if (t->priority == priority)
+    return;
+
+  old_level = intr_disable ();
+  if (t->status == THREAD_READY && !is_idle_thread (t))
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else
+    {
+      t->priority = priority;
+      sema_waiter_update (t);
+    }
+  intr_set_level (old_level);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -660,6 +883,9 @@ thread_schedule_tail (struct thread *prev)
     {
       ASSERT (prev != cur);
       // palloc_free_page (prev);
+
+      /* Thread page cache */
+      thread_put (prev);
     }
 }
 
@@ -681,11 +907,108 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  schedtrace_record (SCHED_RUN, next);
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
 }
 
+/* Thread page cache */
+/* Returns a page for a new thread, with a pcb page attached,
+   from the thread cache if possible.  Returns a null pointer if
+   memory is not available. */
+static struct thread *
+thread_cache_get (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (!list_empty (&thread_cache))
+    {
+      t = list_entry (list_pop_front (&thread_cache), struct thread, allelem);
+      thread_cache_cnt--;
+      thread_cache_hits++;
+    }
+  else
+    thread_cache_misses++;
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    {
+      t = palloc_get_page (0);
+      if (t == NULL)
+        return NULL;
+      t->pcb = palloc_get_page (0);
+      if (t->pcb == NULL)
+        {
+          palloc_free_page (t);
+          return NULL;
+        }
+      old_level = intr_disable ();
+      thread_pages++;
+      intr_set_level (old_level);
+    }
+  return t;
+}
+
+/* Thread page cache */
+/* Gives pages in excess of THREAD_CACHE_MAX back to the page
+   allocator. */
+static void
+thread_cache_trim (void)
+{
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  while (thread_cache_cnt > THREAD_CACHE_MAX)
+    {
+      struct thread *t = list_entry (list_pop_front (&thread_cache),
+                                     struct thread, allelem);
+      thread_cache_cnt--;
+      thread_pages--;
+      intr_set_level (old_level);
+
+      palloc_free_page (t->pcb);
+      palloc_free_page (t);
+
+      old_level = intr_disable ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Thread page cache */
+/* Drops a reference to T's page, putting it on the thread cache
+   if that was the last one.  T must not be the running thread
+   unless it still holds another reference. */
+static void
+thread_put (struct thread *t)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  ASSERT (t->ref_cnt > 0);
+  if (--t->ref_cnt == 0)
+    thread_cache_put (t);
+  intr_set_level (old_level);
+}
+
+/* Thread page cache */
+/* Puts T's page, which nothing references, on the thread cache. */
+static void
+thread_cache_put (struct thread *t)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  t->ref_cnt = 0;
+  list_push_front (&thread_cache, &t->allelem);
+  thread_cache_cnt++;
+  intr_set_level (old_level);
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
@@ -705,46 +1028,30 @@ allocate_tid (void)
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
 /* Lab1 - alarm clock */
-bool
-thread_compare_wakeup_ticks (const struct list_elem *p1, const struct list_elem *p2, void *aux UNUSED)
-{
-  return list_entry(p1, struct thread, sleep_elem) -> wakeup_ticks < list_entry(p2, struct thread, sleep_elem) -> wakeup_ticks;
-}
-
-/* Lab1 - alarm clock */
+/* Blocks the current thread until timer tick WAKEUP_TICKS. */
 void
 thread_sleep (int64_t wakeup_ticks)
 {
   enum intr_level old_level = intr_disable ();
   struct thread *current = thread_current ();
 
-  ASSERT (current != idle_thread);
+  ASSERT (!is_idle_thread (current));
   ASSERT (current -> status == THREAD_RUNNING);
 
-  current -> wakeup_ticks = wakeup_ticks;
-  
-  list_insert_ordered (&sleep_list, &current -> sleep_elem, thread_compare_wakeup_ticks, 0);
+  alarm_set (&current -> sleep_alarm, wakeup_ticks);
+  schedtrace_record (SCHED_SLEEP, current);
   thread_block ();
 
   intr_set_level (old_level);
 }
 
 /* Lab1 - alarm clock */
-void
-thread_wakeup (int64_t current_ticks)
+/* Alarm function that wakes up sleeping thread T_.
+   Runs in the timer interrupt. */
+static void
+thread_wakeup (void *t_)
 {
-  struct list_elem *element = list_begin (&sleep_list);
-
-  while (element != list_end (&sleep_list))
-  {
-    struct thread *thread_ = list_entry (element, struct thread, sleep_elem);
-
-    if (thread_ -> wakeup_ticks > current_ticks)
-      break;
-    
-    element = list_remove (element);
-    thread_unblock (thread_);
-  }
+  thread_unblock (t_);
 }
 
 /* Lab1 - priority scheduling */
@@ -758,134 +1065,309 @@ thread_compare_priority (const struct list_elem *p1, const struct list_elem *p2,
 void
 thread_validate_priority (void)
 {
-  /* If current thread has lower priority than the highest priority of ready_list,
-     it should be re-scheduled. So, just yield the current thread. */
-  if (!list_empty (&ready_list) && thread_current () -> priority < list_entry (list_front (&ready_list), struct thread, elem) -> priority)
-    thread_yield ();
+  /* If current thread has lower priority than the highest priority of the run
+     queues, it should be re-scheduled. So, just yield the current thread.
+     Any bit of our run queue's bitmap above the current priority
+     means so.  In an interrupt handler, yield once it returns. */
+  struct thread *current = thread_current ();
+  int priority = current -> priority;
+  if (priority < PRI_MAX && (current -> cpu -> rq.bitmap >> (priority + 1)) != 0)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
 }
 
 /* Lab1 - priority donation */
-bool
-thread_compare_donation_priority (const struct list_elem *p1, const struct list_elem *p2, void *aux UNUSED)
+/* Orders locks held by a thread by the highest priority donated
+   through each. */
+static bool
+held_lock_less (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
 {
-  return list_entry (p1, struct thread, donation_elem) -> priority > list_entry (p2, struct thread, donation_elem) -> priority;
+  return heap_entry (a, struct lock, elem) -> priority < heap_entry (b, struct lock, elem) -> priority;
 }
 
 /* Lab1 - priority donation */
-void
-donate_priority (void)
+/* Recomputes the priority LOCK passes on to its holder from its
+   donors, and restores its place among the holder's locks.
+   Must be called with interrupts off. */
+static void
+lock_update_priority (struct lock *lock)
 {
-  int depth;
-  struct thread *current = thread_current ();
-  for (depth = 0; depth < DONATION_MAX_DEPTH; depth++)
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock -> priority = (heap_empty (&lock -> donors) ? PRI_MIN
+                      : heap_entry (heap_top (&lock -> donors), struct thread, donation_elem) -> priority);
+  if (lock -> holder != NULL)
+    heap_update (&lock -> holder -> held_locks, &lock -> elem);
+}
+
+/* Lab1 - priority donation */
+/* Recomputes T's priority from its own priority and the top of
+   its held locks, then carries the change up the chain of lock
+   holders T is waiting on.  Only the links whose priority
+   actually changes are visited, so there is no depth limit and
+   a deadlock cycle still terminates.  Must be called with
+   interrupts off. */
+static void
+donation_propagate (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (;;)
   {
-    if (!current -> _lock) break;
-    struct thread *holder = current -> _lock -> holder;
-    /* No need to validate about priority. Currently running thread must have
-      higher priority. No doubts. */
-    holder -> priority = current -> priority;
-    current = holder;
+    int priority = t -> priority_original;
+    if (!heap_empty (&t -> held_locks))
+    {
+      struct lock *top = heap_entry (heap_top (&t -> held_locks), struct lock, elem);
+      if (top -> priority > priority)
+        priority = top -> priority;
+    }
+    if (priority == t -> priority)
+      break;
+    thread_set_effective_priority (t, priority);
+    schedtrace_record (SCHED_DONATE_PRIORITY, t);
+
+    if (t -> _lock == NULL)
+      break;
+    heap_update (&t -> _lock -> donors, &t -> donation_elem);
+    lock_update_priority (t -> _lock);
+    if (t -> _lock -> holder == NULL)
+      break;
+    t = t -> _lock -> holder;
   }
 }
 
 /* Lab1 - priority donation */
+/* The current thread is about to wait for LOCK: donates its
+   priority to LOCK's holder, and transitively to whatever that
+   holder is waiting for. */
 void
-update_donation ()
+donate_priority (struct lock *lock)
 {
   struct thread *current = thread_current ();
-  current -> priority = current -> priority_original;
-  if (!list_empty (&current -> donation_list))
-  {
-    struct thread *p1;
-    
-    list_sort (&current -> donation_list, thread_compare_donation_priority, 0);
-    
-    p1 = list_entry (list_front (&current -> donation_list), struct thread, donation_elem);
-    
-    if (p1 -> priority > current -> priority)
-      current -> priority = p1 -> priority;
-  }
+  enum intr_level old_level;
+
+  ASSERT (current -> _lock == NULL);
+
+  old_level = intr_disable ();
+  current -> _lock = lock;
+  heap_push (&lock -> donors, &current -> donation_elem);
+  schedtrace_record (SCHED_DONATE_BEGIN, current);
+  lock_update_priority (lock);
+  if (lock -> holder != NULL)
+    donation_propagate (lock -> holder);
+  intr_set_level (old_level);
+}
+
+/* Lab1 - priority donation */
+/* The current thread is no longer waiting for the lock it
+   donated to: takes its donation back. */
+void
+withdraw_donation (void)
+{
+  struct thread *current = thread_current ();
+  struct lock *lock = current -> _lock;
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+
+  old_level = intr_disable ();
+  heap_remove (&lock -> donors, &current -> donation_elem);
+  current -> _lock = NULL;
+  schedtrace_record (SCHED_DONATE_END, current);
+  lock_update_priority (lock);
+  if (lock -> holder != NULL)
+    donation_propagate (lock -> holder);
+  intr_set_level (old_level);
+}
+
+/* Lab1 - priority donation */
+/* The current thread has acquired LOCK: threads still waiting
+   for it now donate to us. */
+void
+add_donation (struct lock *lock)
+{
+  struct thread *current = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (lock -> holder == current);
+
+  old_level = intr_disable ();
+  heap_push (&current -> held_locks, &lock -> elem);
+  lock_update_priority (lock);
+  donation_propagate (current);
+  intr_set_level (old_level);
 }
 
 /* Lab1 - priority donation */
+/* The current thread is releasing LOCK: drops the donations
+   made through it.  Only the top of the remaining held locks
+   needs to be consulted. */
 void
 remove_donation (struct lock *lock)
 {
-  struct thread *thread = thread_current ();
-  struct list_elem *element = list_begin (&thread -> donation_list);
-  while (element != list_end (&thread -> donation_list))
-  {
-    struct thread *donor = list_entry (element, struct thread, donation_elem);
-    if (donor -> _lock == lock) element = list_remove (&donor -> donation_elem);
-    else element = list_next (element);
-  }
+  struct thread *current = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (lock -> holder == current);
+
+  old_level = intr_disable ();
+  heap_remove (&current -> held_locks, &lock -> elem);
+  donation_propagate (current);
+  intr_set_level (old_level);
+}
+
+/* Lab1 - priority donation */
+/* Recomputes the current thread's priority after its own
+   priority has changed. */
+void
+update_donation (void)
+{
+  enum intr_level old_level = intr_disable ();
+  donation_propagate (thread_current ());
+  intr_set_level (old_level);
 }
 
 /* Lab1 - MLFQS */
 void
 mlfqs_update_priority (struct thread *thread)
 {
-  if (thread == idle_thread) return;
+  if (is_idle_thread (thread)) return;
   // Hotfix #2
   int priority = fp_int_round (fp_add (fp_div (thread -> recent_cpu, int_fp (-4)), int_fp (PRI_MAX - thread -> nice * 2)));
   if (priority > PRI_MAX) priority = PRI_MAX;
   if (priority < PRI_MIN) priority = PRI_MIN;
-  thread -> priority = priority;
+  thread_set_effective_priority (thread, priority);
 }
 
 /* Lab1 - MLFQS */
+/* Recomputes the priority of every thread whose recent_cpu has
+   changed since the last recomputation.  The inputs of every
+   other thread's priority are unchanged, so this gives the same
+   result as recomputing all of them. */
 void 
 mlfqs_update_priority_all (void)
 {
-  struct list_elem *element = list_begin (&all_list);
-  while (element != list_end (&all_list))
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&mlfqs_dirty_list))
   {
-    mlfqs_update_priority (list_entry (element, struct thread, allelem));
-    element = list_next (element);
+    struct thread *thread = list_entry (list_pop_front (&mlfqs_dirty_list), struct thread, mlfqs_elem);
+    thread -> mlfqs_dirty = false;
+    mlfqs_update_recent_cpu (thread);
+    mlfqs_update_priority (thread);
   }
-  // Hotfix #1
-  list_sort (&ready_list, thread_compare_priority, 0);
 }
 
 /* Lab1 - MLFQS */
+/* Applies to THREAD's recent_cpu the decays of every epoch it has
+   missed. */
 void
 mlfqs_update_recent_cpu (struct thread *thread)
 {
-  if (thread == idle_thread) return;
-  int k = fp_mul (int_fp (2), load_avg);      // fp
-  int a = fp_div (k, fp_add (k, int_fp (1))); // fp
-  thread -> recent_cpu = fp_add (fp_mul (a, thread -> recent_cpu), int_fp (thread -> nice));
+  if (is_idle_thread (thread)) return;
+  while (thread -> mlfqs_epoch != mlfqs_epoch)
+  {
+    int a = mlfqs_decay[++thread -> mlfqs_epoch % FP_DECAY_EPOCHS];  // fp
+    thread -> recent_cpu = fp_add (fp_mul (a, thread -> recent_cpu), int_fp (thread -> nice));
+  }
 }
 
 /* Lab1 - MLFQS */
+/* Starts a new decay epoch.  Decays the running thread and the
+   ready threads now, since they are the ones the scheduler looks
+   at; blocked threads catch up in mlfqs_refresh(). */
 void
 mlfqs_update_recent_cpu_all (void)
 {
-  struct list_elem *element = list_begin (&all_list);
-  while (element != list_end (&all_list))
+  int k = fp_mul (int_fp (2), load_avg);      // fp
+  int a = fp_div (k, fp_add (k, int_fp (1))); // fp
+  struct list_elem *element;
+  int priority;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  mlfqs_decay[++mlfqs_epoch % FP_DECAY_EPOCHS] = a;
+
+  if (mlfqs_epoch % FP_DECAY_EPOCHS == 0)
+  {
+    /* The table is about to wrap around. */
+    for (element = list_begin (&all_list); element != list_end (&all_list); element = list_next (element))
+      mlfqs_mark_dirty (list_entry (element, struct thread, allelem));
+  }
+  else
   {
-    mlfqs_update_recent_cpu (list_entry (element, struct thread, allelem));
-    element = list_next (element);
+    mlfqs_mark_dirty (thread_current ());
+    for (i = 0; i < cpu_cnt; i++)
+    {
+      struct run_queue *rq = &cpus[i].rq;
+      enum intr_level old_level = spinlock_acquire (&rq->lock);
+      for (priority = PRI_MIN; priority <= PRI_MAX; priority++)
+        for (element = list_begin (&rq->queues[priority]); element != list_end (&rq->queues[priority]); element = list_next (element))
+          mlfqs_mark_dirty (list_entry (element, struct thread, elem));
+      spinlock_release (&rq->lock, old_level);
+    }
   }
+
+  for (element = list_begin (&mlfqs_dirty_list); element != list_end (&mlfqs_dirty_list); element = list_next (element))
+    mlfqs_update_recent_cpu (list_entry (element, struct thread, mlfqs_elem));
 }
 
 /* Lab1 - MLFQS */
 void
 mlfqs_update_recent_cpu_tick (void)
 {
-  if (thread_current () != idle_thread)
-    thread_current () -> recent_cpu = fp_add (thread_current () -> recent_cpu, int_fp (1));
+  struct thread *current = thread_current ();
+  if (!is_idle_thread (current))
+  {
+    current -> recent_cpu = fp_add (current -> recent_cpu, int_fp (1));
+    mlfqs_mark_dirty (current);
+  }
 }
 
 /* Lab1 - MLFQS */
 void
 mlfqs_update_load_avg  (void)
 {
-  int ready_threads = list_size (&ready_list);
-  if (thread_current () != idle_thread) ready_threads ++;
-  int a = fp_div (int_fp (59), int_fp(60)); // fp
-  int b = fp_div (int_fp (1), int_fp(60));  // fp
-  load_avg = fp_add (fp_mul (a, load_avg), fp_mul (b, int_fp (ready_threads)));
+  int ready_threads = 0;
+  int i;
+  for (i = 0; i < cpu_cnt; i++)
+    ready_threads += cpus[i].rq.cnt;
+  if (!is_idle_thread (thread_current ())) ready_threads ++;
+  load_avg = fp_add (fp_mul (FP_LOAD_DECAY, load_avg), fp_mul (FP_LOAD_GAIN, int_fp (ready_threads)));
+}
+
+/* Lab1 - MLFQS */
+/* Brings THREAD's recent_cpu, and so its priority, up to date
+   with the decay epochs that went by while it was blocked.  Must
+   be called before a blocked thread's priority is used. */
+void
+mlfqs_refresh (struct thread *thread)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (is_idle_thread (thread) || thread -> mlfqs_epoch == mlfqs_epoch) return;
+  mlfqs_update_recent_cpu (thread);
+  /* A dirty thread keeps its priority until the next 4-tick
+     recomputation, as it would have under a full sweep. */
+  if (!thread -> mlfqs_dirty)
+    mlfqs_update_priority (thread);
+}
+
+/* Lab1 - MLFQS */
+/* Queues THREAD for the next priority recomputation. */
+static void
+mlfqs_mark_dirty (struct thread *thread)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (is_idle_thread (thread) || thread -> mlfqs_dirty) return;
+  thread -> mlfqs_dirty = true;
+  list_push_back (&mlfqs_dirty_list, &thread -> mlfqs_elem);
 }
 
 /* Lab2 - systemCall & fileSystem */
@@ -896,16 +1378,39 @@ thread_get_child (tid_t child_tid)
 {
   struct list *child_list = &(thread_current () -> child_list);
   struct list_elem *elem;
+  struct thread *found = NULL;
 
+  /* Children that never load a process drop off this list by
+     themselves when they exit. */
+  enum intr_level old_level = intr_disable ();
   for (elem = list_begin (child_list); elem != list_end (child_list); elem = list_next (elem))
   {
     struct thread *child = list_entry (elem, struct thread, childelem);
     
     if (child -> tid == child_tid)
-      return child;
+    {
+      found = child;
+      break;
+    }
   }
+  intr_set_level (old_level);
 
-  return NULL;
+  return found;
+}
+
+/* Thread page cache */
+/* Removes CHILD from its parent's child list and drops the
+   parent's reference to it.  Called once the parent has waited
+   for CHILD, or when no one will wait for it any more. */
+void
+thread_release_child (struct thread *child)
+{
+  enum intr_level old_level = intr_disable ();
+  ASSERT (child -> parent != NULL);
+  list_remove (&(child -> childelem));
+  child -> parent = NULL;
+  thread_put (child);
+  intr_set_level (old_level);
 }
 
 /* Return pcb pointer of child of current process. */
@@ -921,7 +1426,9 @@ init_mmf (int mmfid, void *upage, struct file *file)
 {
   struct thread *thread = thread_current ();
   struct hash *spt = &(thread -> spt);
-  struct mmf *mmf = (struct mmf *) malloc (sizeof *mmf);
+  struct mmf *mmf = kmem_cache_alloc (mmf_cache);
+  if (mmf == NULL)
+    return NULL;
   
   mmf -> id = mmfid;
   mmf -> upage = upage;
@@ -930,7 +1437,11 @@ init_mmf (int mmfid, void *upage, struct file *file)
   off_t size = file_length (file);
 
   for (off_t ofs = 0; ofs < size; ofs += PGSIZE)
-    if (get_spte (spt, upage + ofs) != NULL) return NULL;
+    if (get_spte (spt, upage + ofs) != NULL)
+    {
+      kmem_cache_free (mmf_cache, mmf);
+      return NULL;
+    }
 
   for (off_t ofs = 0; ofs < size; ofs += PGSIZE)
   {
@@ -940,7 +1451,8 @@ init_mmf (int mmfid, void *upage, struct file *file)
     else
       read_bytes = size - ofs;
     
-    spalloc_file (spt, upage + ofs, file, ofs, read_bytes, PGSIZE - read_bytes, true);
+    struct spte *entry = spalloc_file (spt, upage + ofs, file, ofs, read_bytes, PGSIZE - read_bytes, true);
+    entry -> mmap = true;
   }
 
   list_push_back (&(thread -> mmf_list), &(mmf -> list_elem));
@@ -960,4 +1472,10 @@ get_mmf (int mmfid)
       return mmf;
   }
   return NULL;
+}
+
+void
+free_mmf (struct mmf *mmf)
+{
+  kmem_cache_free (mmf_cache, mmf);
 }
\ No newline at end of file
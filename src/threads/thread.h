@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "devices/timer.h"
 
 /* lab3 - supplemental page table */
 #include <hash.h>
@@ -30,9 +31,6 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
-/* Lab1 - priority donation */
-#define DONATION_MAX_DEPTH 8
-
 /* Lab1 - MLFQS */
 #define NICE_MIN -20
 #define NICE_DEFAULT 0
@@ -48,6 +46,7 @@ struct pcb
       /* status */
       bool isexited;
       bool isloaded;
+      bool isprocess;
 
       /* sync for load & wait */
       struct semaphore load;
@@ -134,6 +133,7 @@ struct thread
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
+    struct cpu *cpu;                    /* CPU whose run queue we use. */
     struct list_elem allelem;           /* List element for all threads list. */
 
     /* Shared between thread.c and synch.c. */
@@ -152,10 +152,21 @@ struct thread
 
    /* lab3 - supplemental page table */
    struct hash spt;
+   struct lock spt_lock;                /* Guards SPT against the evictor. */
 
    /* lab3 - stack growth */
    void *esp;
 
+   /* lab3 - working set */
+   int64_t vm_ticks;                    /* Ticks run: virtual time. */
+
+   /* lab3 - fault-around */
+   void *fault_next;                    /* Next fault of a sequential run. */
+   void *ahead_start;                   /* First page mapped ahead... */
+   uint32_t ahead_mask;                 /* ...and which were mapped ahead. */
+   size_t ahead_window;                 /* Pages to map ahead next time. */
+   long long faults_avoided;            /* Mapped ahead, then used. */
+
    /* lab3 - MMF */
    int mmfid;
    struct list mmf_list;
@@ -164,18 +175,33 @@ struct thread
     unsigned magic;                     /* Detects stack overflow. */
 
     /* Lab1 - alarm clock */
-    int64_t wakeup_ticks;
-    struct list_elem sleep_elem;
+    struct alarm sleep_alarm;
     
     /* Lab1 - priority donation */
     int priority_original;
-    struct lock *_lock;
-    struct list donation_list;
-    struct list_elem donation_elem;
+    struct lock *_lock;                 /* Lock we are donating to. */
+    struct heap held_locks;             /* Locks held, by donated priority. */
+    struct heap_elem donation_elem;     /* Element in _LOCK's donors. */
+
+    /* Lab1 - priority scheduling */
+    struct heap_elem wait_elem;         /* Element in sema waiters. */
+    struct semaphore *wait_sema;        /* Semaphore being waited on. */
+    struct condition *wait_cond;        /* Condition being waited on. */
+    struct semaphore_elem *cond_waiter; /* Our element in WAIT_COND. */
+    unsigned wait_seq;                  /* Arrival order in WAIT_SEMA. */
+
+    /* Reader-writer locks */
+    struct rwlock *rwlock_reading;      /* rwlock held for reading. */
     
     /* Lab1 - MLFQS */
     int nice;
     int recent_cpu;
+    int mlfqs_epoch;                    /* Last decay applied to recent_cpu. */
+    bool mlfqs_dirty;                   /* Priority needs recomputing? */
+    struct list_elem mlfqs_elem;        /* Element in MLFQS dirty list. */
+
+    /* Thread page cache */
+    int ref_cnt;                        /* References to this page. */
   };
 
 /* If false (default), use round-robin scheduler.
@@ -215,19 +241,18 @@ int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
 /* Lab1 - alarm clock */
-bool thread_compare_wakeup_ticks (const struct list_elem *p1, const struct list_elem *p2, void *aux UNUSED);
 void thread_sleep (int64_t wakeup_tick);
-void thread_wakeup (int64_t current_tick);
 
 /* Lab1 - priority scheduling */
 bool thread_compare_priority (const struct list_elem *p1, const struct list_elem *p2, void *aux UNUSED);
 void thread_validate_priority (void);
 
 /* Lab1 - priority donation */
-bool thread_compare_donation_priority (const struct list_elem *p1, const struct list_elem *p2, void *aux UNUSED);
-void donate_priority (void);
-void update_donation (void);
+void donate_priority (struct lock *lock);
+void withdraw_donation (void);
+void add_donation (struct lock *lock);
 void remove_donation (struct lock *lock);
+void update_donation (void);
 
 /* Lab1 - MLFQS */
 void mlfqs_update_priority (struct thread *thread);
@@ -236,13 +261,16 @@ void mlfqs_update_recent_cpu (struct thread *thread);
 void mlfqs_update_recent_cpu_all (void);
 void mlfqs_update_recent_cpu_tick (void);
 void mlfqs_update_load_avg  (void);
+void mlfqs_refresh (struct thread *thread);
 
 /* Lab2 - fileSystem */
 struct thread *thread_get_child (tid_t child_tid);
 struct pcb *thread_get_child_pcb (tid_t child_tid);
+void thread_release_child (struct thread *child);
 
 /* lab3 - MMF */
 struct mmf *init_mmf (int mmfid, void *upage, struct file *file);
 struct mmf *get_mmf (int mmfid);
+void free_mmf (struct mmf *mmf);
 
 #endif /* threads/thread.h */
@@ -0,0 +1,289 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Number of workers in the system queue. */
+#define SYSTEM_WQ_WORKERS 2
+
+/* Shared queue for work that does not need a queue of its own. */
+struct workqueue system_wq;
+
+/* List of all work queues, for statistics. */
+static struct list all_queues = LIST_INITIALIZER (all_queues);
+
+static thread_func worker;
+static void work_timer (void *work_);
+
+/* Initializes the work queue subsystem and starts the system
+   queue's workers.  Must be called after thread_start(). */
+void
+workqueue_init (void)
+{
+  if (!workqueue_create (&system_wq, "system", SYSTEM_WQ_WORKERS,
+                         PRI_DEFAULT))
+    PANIC ("could not start system work queue");
+}
+
+/* Initializes WQ as a work queue named NAME and starts WORKERS
+   worker threads for it at the given PRIORITY.  Returns true if
+   successful, false if not all of the workers could be
+   started; WQ is still usable as long as at least one was. */
+bool
+workqueue_create (struct workqueue *wq, const char *name,
+                  size_t workers, int priority)
+{
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (wq != NULL);
+  ASSERT (workers > 0 && workers <= WORKQUEUE_MAX_WORKERS);
+
+  wq->name = name;
+  list_init (&wq->pending);
+  sema_init (&wq->work_sema, 0);
+  wq->workers = 0;
+  wq->running = 0;
+  lock_init (&wq->lock);
+  cond_init (&wq->idle);
+  wq->depth = wq->max_depth = 0;
+  wq->completed = wq->cancelled = 0;
+  wq->total_latency = wq->max_latency = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_queues, &wq->elem);
+  intr_set_level (old_level);
+
+  for (i = 0; i < workers; i++)
+    {
+      char thread_name[16];
+
+      snprintf (thread_name, sizeof thread_name, "%s/%zu", name, i);
+      if (thread_create (thread_name, priority, worker, wq) == TID_ERROR)
+        break;
+      wq->workers++;
+    }
+  return wq->workers == workers;
+}
+
+/* Initializes WORK to call FUNC, which may retrieve AUX from
+   WORK->aux. */
+void
+work_init (struct work *work, work_func *func, void *aux)
+{
+  ASSERT (work != NULL);
+  ASSERT (func != NULL);
+
+  work->func = func;
+  work->aux = aux;
+  work->wq = NULL;
+  work->pending = false;
+  alarm_init (&work->alarm, work_timer, work);
+}
+
+/* Queues WORK to be run by one of WQ's workers.  Returns false,
+   without doing anything, if WORK is already pending, true
+   otherwise.  May be called from an interrupt handler. */
+bool
+queue_work (struct workqueue *wq, struct work *work)
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  old_level = intr_disable ();
+  if (!work->pending && !alarm_pending (&work->alarm))
+    {
+      work->wq = wq;
+      work->pending = true;
+      work->queued = timer_ticks ();
+      list_push_back (&wq->pending, &work->elem);
+      if (++wq->depth > wq->max_depth)
+        wq->max_depth = wq->depth;
+      sema_up (&wq->work_sema);
+      queued = true;
+    }
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Queues WORK on WQ once TICKS timer ticks have passed.  Returns
+   false, without doing anything, if WORK is already pending,
+   true otherwise.  May be called from an interrupt handler. */
+bool
+queue_delayed_work (struct workqueue *wq, struct work *work,
+                    int64_t ticks)
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  if (ticks <= 0)
+    return queue_work (wq, work);
+
+  old_level = intr_disable ();
+  if (!work->pending && !alarm_pending (&work->alarm))
+    {
+      work->wq = wq;
+      alarm_set (&work->alarm, timer_ticks () + ticks);
+      queued = true;
+    }
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Alarm callback for delayed work. */
+static void
+work_timer (void *work_)
+{
+  struct work *work = work_;
+
+  queue_work (work->wq, work);
+}
+
+/* Cancels WORK if it is pending, delayed or not.  Returns true
+   if WORK was pending, false otherwise.  Does not wait for WORK
+   if it is already running; use workqueue_flush() for that.  May
+   be called from an interrupt handler. */
+bool
+work_cancel (struct work *work)
+{
+  enum intr_level old_level;
+  bool cancelled = false;
+
+  old_level = intr_disable ();
+  if (alarm_cancel (&work->alarm))
+    cancelled = true;
+  else if (work->pending)
+    {
+      struct workqueue *wq = work->wq;
+
+      list_remove (&work->elem);
+      work->pending = false;
+      wq->depth--;
+      wq->cancelled++;
+
+      /* The queue's semaphore now counts one item too many.  Let
+         a worker consume it, so that it notices if the queue has
+         gone idle. */
+      cancelled = true;
+    }
+  intr_set_level (old_level);
+
+  return cancelled;
+}
+
+/* Returns true if WORK is queued or waiting for its delay to
+   expire, false otherwise. */
+bool
+work_pending (const struct work *work)
+{
+  return work->pending || alarm_pending (&work->alarm);
+}
+
+/* Returns true if WQ has no pending or running work.  Must be
+   called with interrupts off. */
+static bool
+workqueue_idle (const struct workqueue *wq)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  return wq->depth == 0 && wq->running == 0;
+}
+
+/* Waits until all the work queued on WQ so far has finished
+   running.  Delayed work whose delay has not yet expired is not
+   waited for.  Must not be called by one of WQ's own workers. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  enum intr_level old_level;
+  bool idle;
+
+  ASSERT (!intr_context ());
+
+  lock_acquire (&wq->lock);
+  for (;;)
+    {
+      old_level = intr_disable ();
+      idle = workqueue_idle (wq);
+      intr_set_level (old_level);
+      if (idle)
+        break;
+      cond_wait (&wq->idle, &wq->lock);
+    }
+  lock_release (&wq->lock);
+}
+
+/* Worker thread.  Runs work from the queue passed as WQ_ as it
+   arrives. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *work = NULL;
+      bool idle;
+
+      sema_down (&wq->work_sema);
+
+      old_level = intr_disable ();
+      if (!list_empty (&wq->pending))
+        {
+          int64_t latency;
+
+          work = list_entry (list_pop_front (&wq->pending),
+                             struct work, elem);
+          work->pending = false;
+          wq->depth--;
+          wq->running++;
+
+          latency = timer_ticks () - work->queued;
+          wq->total_latency += latency;
+          if (latency > wq->max_latency)
+            wq->max_latency = latency;
+        }
+      intr_set_level (old_level);
+
+      /* WORK may be freed or requeued by its own function, so it
+         must not be touched afterward. */
+      if (work != NULL)
+        work->func (work);
+
+      lock_acquire (&wq->lock);
+      old_level = intr_disable ();
+      if (work != NULL)
+        {
+          wq->running--;
+          wq->completed++;
+        }
+      idle = workqueue_idle (wq);
+      intr_set_level (old_level);
+      if (idle)
+        cond_broadcast (&wq->idle, &wq->lock);
+      lock_release (&wq->lock);
+    }
+}
+
+/* Prints work queue statistics. */
+void
+workqueue_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_queues); e != list_end (&all_queues);
+       e = list_next (e))
+    {
+      struct workqueue *wq = list_entry (e, struct workqueue, elem);
+
+      printf ("Workqueue %s: %lld completed, %lld cancelled, "
+              "%zu max depth, %lld avg/%lld max latency ticks\n",
+              wq->name, wq->completed, wq->cancelled, wq->max_depth,
+              wq->completed > 0 ? wq->total_latency / wq->completed : 0,
+              wq->max_latency);
+    }
+}
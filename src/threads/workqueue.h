@@ -0,0 +1,80 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/timer.h"
+#include "threads/synch.h"
+
+/* Work queues.
+
+   A work queue is a bounded pool of kernel worker threads that
+   run work items on behalf of other code, so that things like
+   writeback, page zeroing and prefetching can be taken off the
+   path of the thread that is waiting on them.  Work can be
+   queued from any context, including interrupt handlers, either
+   immediately or after a delay in timer ticks. */
+
+struct work;
+struct workqueue;
+typedef void work_func (struct work *);
+
+/* A unit of deferred work.  Embed one in the structure the work
+   operates on and use list_entry-style pointer arithmetic, or
+   AUX, to get back to it.  A work item may free itself from its
+   function, but must not be freed while it is pending. */
+struct work
+  {
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    struct workqueue *wq;       /* Queue it was last queued on. */
+    bool pending;               /* On WQ's pending list? */
+    int64_t queued;             /* Tick at which it was queued. */
+    struct list_elem elem;      /* Element in WQ's pending list. */
+    struct alarm alarm;         /* Fires delayed work. */
+  };
+
+/* Most worker threads a single queue may have. */
+#define WORKQUEUE_MAX_WORKERS 8
+
+/* A work queue. */
+struct workqueue
+  {
+    const char *name;           /* Name, for statistics. */
+    struct list pending;        /* Queued work, oldest first. */
+    struct semaphore work_sema; /* Upped once per queued item. */
+    size_t workers;             /* Number of worker threads. */
+    size_t running;             /* Workers currently running work. */
+    struct lock lock;           /* Protects waiting for idle. */
+    struct condition idle;      /* Signaled when queue goes idle. */
+    struct list_elem elem;      /* Element in list of all queues. */
+
+    /* Statistics. */
+    size_t depth;               /* Items currently pending. */
+    size_t max_depth;           /* Largest DEPTH seen. */
+    long long completed;        /* Items run to completion. */
+    long long cancelled;        /* Items cancelled while pending. */
+    int64_t total_latency;      /* Ticks from queueing to start. */
+    int64_t max_latency;        /* Largest single latency. */
+  };
+
+/* Shared queue for work that does not need a queue of its own. */
+extern struct workqueue system_wq;
+
+void workqueue_init (void);
+bool workqueue_create (struct workqueue *, const char *name,
+                       size_t workers, int priority);
+
+void work_init (struct work *, work_func *, void *aux);
+bool queue_work (struct workqueue *, struct work *);
+bool queue_delayed_work (struct workqueue *, struct work *,
+                         int64_t ticks);
+bool work_cancel (struct work *);
+bool work_pending (const struct work *);
+void workqueue_flush (struct workqueue *);
+
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
@@ -110,6 +110,10 @@ start_process (void *command_)
   struct intr_frame if_;
   bool success;
 
+  /* Thread page cache */
+  /* Our parent may wait for us, so keep its reference on exit. */
+  thread_current () -> pcb -> isprocess = true;
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
@@ -189,16 +193,18 @@ process_wait (tid_t child_tid)
     return -1;
   
   struct pcb *pcb = child -> pcb;
+  int exitcode = -1;
   
-  if (pcb == NULL || !pcb -> isloaded)
-    return -1;
-  
-  sema_down (&(pcb -> wait));
-  int exitcode = pcb -> exitcode;
+  if (pcb -> isloaded)
+  {
+    sema_down (&(pcb -> wait));
+    exitcode = pcb -> exitcode;
+  }
 
-  list_remove (&(child -> childelem));
-  palloc_free_page (child -> pcb);
-  palloc_free_page (child);
+  /* Thread page cache */
+  /* The child's page goes back to the thread cache once it has
+     also been switched away from for the last time. */
+  thread_release_child (child);
 
   return exitcode;
 }
@@ -220,6 +226,12 @@ process_exit (void)
   for (i = 0; i < cur -> mmfid; i++)
     syscall_munmap (i);
 
+  /* lab3 - fault-around */
+  spt_fault_ahead_done ();
+
+  /* lab3 - frame table */
+  falloc_free_thread (cur);
+
   /* lab3 - supplemental page table */
   destroy_spt (&(cur -> spt));
 
@@ -589,6 +601,7 @@ setup_stack (void **esp)
       if (success)
       {
         spalloc_frame (&(thread_current () -> spt), PHYS_BASE - PGSIZE, kpage);
+        falloc_unpin (kpage);
         *esp = PHYS_BASE;
       }
       else
@@ -20,7 +20,10 @@
 #include "vm/falloc.h"
 #include "vm/spt.h"
 
-struct lock file_lock;
+/* Lab2 - fileSystem */
+/* Reads of open files may run concurrently; everything else
+   touching the file system holds it for writing. */
+struct rwlock file_lock;
 
 static void syscall_handler (struct intr_frame *);
 
@@ -30,7 +33,7 @@ syscall_init (void)
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 
   /* Lab2 - fileSystem */
-  lock_init (&file_lock);
+  rwlock_init (&file_lock);
 }
 
 static void
@@ -186,7 +189,7 @@ syscall_exec (const char *cmd_line)
   pid_t pid = process_execute (cmd_line);
   struct pcb *pcb = thread_get_child_pcb (pid);
   
-  if (pid == -1 || !pcb -> isloaded)
+  if (pid == -1 || pcb == NULL || !pcb -> isloaded)
     return -1;
   
   return pid;
@@ -222,11 +225,11 @@ int
 syscall_open (const char *file)
 {
   /* Lab2 - fileSystem */
-  lock_acquire (&file_lock);
+  rwlock_acquire_write (&file_lock);
 
   if (!is_valid_vaddr (file))
   {
-    lock_release (&file_lock);
+    rwlock_release_write (&file_lock);
     syscall_exit (-1);
   }
   
@@ -234,7 +237,7 @@ syscall_open (const char *file)
   
   if(file_ == NULL)
   {
-    lock_release (&file_lock);
+    rwlock_release_write (&file_lock);
     return -1;
   }
   
@@ -247,7 +250,7 @@ syscall_open (const char *file)
 
   pcb -> fdtable[pcb -> fdcount] = file_;
 
-  lock_release (&file_lock);
+  rwlock_release_write (&file_lock);
   
   return pcb -> fdcount++;
 }
@@ -273,11 +276,11 @@ syscall_read (int fd, void *buffer, unsigned size)
     syscall_exit (-1);
   
   /* Lab2 - fileSystem */
-  lock_acquire (&file_lock);
+  rwlock_acquire_read (&file_lock);
   
   int read_size = file_read (file, buffer, size);
   
-  lock_release (&file_lock);
+  rwlock_release_read (&file_lock);
   
   return read_size;
 
@@ -297,11 +300,11 @@ syscall_write (int fd, void *buffer, unsigned size)
   /* stdout */
   if (fd == 1)
   {
-    lock_acquire (&file_lock);
+    rwlock_acquire_write (&file_lock);
     
     putbuf (buffer, size);
     
-    lock_release(&file_lock);
+    rwlock_release_write (&file_lock);
     
     return size;
   }
@@ -313,11 +316,11 @@ syscall_write (int fd, void *buffer, unsigned size)
       syscall_exit (-1);
     
     /* Lab2 - fileSystem */
-    lock_acquire (&file_lock);
+    rwlock_acquire_write (&file_lock);
     
     int write_size = file_write (file, buffer, size);
     
-    lock_release (&file_lock);
+    rwlock_release_write (&file_lock);
     
     return write_size;
     
@@ -398,25 +401,25 @@ syscall_mmap (int fd, void *vaddr)
   if (file == NULL)
     return -1;
 
-  lock_acquire (&file_lock);
+  rwlock_acquire_write (&file_lock);
 
   struct file *file_r = file_reopen (file);
   if (file_r == NULL)
   {
-    lock_release (&file_lock);
+    rwlock_release_write (&file_lock);
     return -1;
   }
   
   struct mmf *mmf = init_mmf (thread -> mmfid, vaddr, file_r);
   if (mmf == NULL)
   {
-    lock_release (&file_lock);
+    rwlock_release_write (&file_lock);
     return -1;
   }
   
   thread -> mmfid ++;
 
-  lock_release (&file_lock);
+  rwlock_release_write (&file_lock);
   
   return mmf -> id;
 }
@@ -443,18 +446,34 @@ syscall_munmap (int mmfid)
   if (elem == list_end (mmf_list))
     return;
 
-  lock_acquire (&file_lock);
-
+  rwlock_acquire_read (&file_lock);
   off_t size = file_length (mmf -> file);
+  rwlock_release_read (&file_lock);
+
   for (off_t ofs = 0; ofs < size; ofs += PGSIZE)
   {
-    struct spte *entry = get_spte (spt, (mmf -> upage) + ofs);
-    if (pagedir_is_dirty (thread -> pagedir, (mmf -> upage) + ofs))
-      file_write_at (entry -> file, pagedir_get_page (thread -> pagedir, (mmf -> upage) + ofs), entry -> read_bytes, entry -> ofs);
+    void *upage = (mmf -> upage) + ofs;
+    struct spte *entry = get_spte (spt, upage);
+
+    /* lab3 - a queued writeback has already cleared the dirty bit,
+       so wait for it before deciding the page is clean. */
+    void *kpage = falloc_hold_page (upage);
+    if (kpage != NULL)
+    {
+      if (pagedir_is_dirty (thread -> pagedir, upage))
+      {
+        rwlock_acquire_write (&file_lock);
+        file_write_at (entry -> file, kpage, entry -> read_bytes, entry -> ofs);
+        rwlock_release_write (&file_lock);
+      }
+      falloc_free_page (kpage);
+    }
     spdealloc (spt, entry);
   }
 
+  rwlock_acquire_write (&file_lock);
   list_remove (elem);
+  free_mmf (mmf);
 
-  lock_release (&file_lock);
+  rwlock_release_write (&file_lock);
 }
\ No newline at end of file
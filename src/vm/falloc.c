@@ -1,42 +1,196 @@
+#include <debug.h>
+#include <stdio.h>
+
+#include "filesys/file.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "vm/falloc.h"
 #include "vm/spt.h"
+#include "vm/swap.h"
+
+/* lab3 - the frame table has one entry for each page of the user
+   pool, indexed by palloc_user_page_idx(), so finding the entry
+   for a kpage needs no search.  CLOCK is the hand of a single
+   clock that sweeps all frames, whichever thread owns them, and
+   checks each frame's accessed bit in its owner's page directory.
+
+   A frame is pinned from when it is allocated until its page has
+   been read in and mapped, and the hand passes over pinned frames:
+   until then, nothing shows that the frame is in use.  The evictor
+   looks up and changes other threads' sptes holding their owner's
+   spt_lock, which the owner takes to change its page table.  The
+   frame table lock comes first, so no thread may wait for it while
+   holding its own spt_lock. */
+extern struct rwlock file_lock;
 
-static struct list frame_table;
+static struct fte *frame_table;
+static size_t frame_cnt;
 static struct lock frame_table_lock;
-static struct list_elem *clock;
+static size_t clock;
+
+/* lab3 - WSClock.  When the hand passes a referenced frame, it
+   clears the accessed bit and stamps the frame with its owner's
+   virtual time (thread's vm_ticks).  An unreferenced frame more
+   than WS_TAU ticks of owner time old has left the working set.
+   If it is clean, meaning its contents are still in its file or
+   in its swap slot, it is evicted without any I/O.  If it is
+   dirty, it is queued for writeback and the hand moves on, so it
+   can be evicted cheaply once written.  At most WRITEBACK_MAX
+   frames are under writeback at a time.  Old dirty frames bound
+   for swap are gathered into clusters of up to SWAP_CLUSTER, which
+   get neighbouring swap slots and are written with one request.
+
+   If two turns of the hand find no old clean frame, a younger
+   clean frame is evicted instead, and failing that the first
+   unreferenced frame that is not mapped from a file is written to
+   swap synchronously. */
+#define WS_TAU 50
+#define WRITEBACK_MAX 16
+
+/* lab3 - dirty frame writeback */
+struct writeback
+{
+    struct work work;
+    struct file *file;              /* Write one frame to this file... */
+    off_t ofs;
+    uint32_t bytes;
+    int swap_id;                    /* ...or CNT frames to swap here. */
+    size_t cnt;
+    struct fte *entries[SWAP_CLUSTER];
+    struct swap_page pages[SWAP_CLUSTER];
+};
+
+/* lab3 - page-out daemon.  Whenever an allocation leaves fewer
+   than LOW_WM free user frames, the "pageout" thread is woken to
+   evict frames until HIGH_WM are free, so that page faults
+   usually find a free frame instead of evicting one themselves. */
+static size_t low_wm, high_wm;
+static struct semaphore pageout_sema;
+static bool pageout_awake;          /* Woken and not yet done? */
+
+static struct workqueue writeback_wq;
+static struct condition writeback_done;
+static size_t writeback_cnt;
+
+/* lab3 - eviction statistics */
+static long long evict_cnt;         /* Frames evicted. */
+static long long direct_evict_cnt;  /* Evicted by faulting threads. */
+static long long pageout_wake_cnt;  /* Times the daemon was woken. */
+static long long clean_evict_cnt;   /* Evicted without writing. */
+static long long writeback_total;   /* Frames queued for writeback. */
+static long long cluster_cnt;       /* Swap writebacks of clusters. */
+static long long sweep_cnt;         /* Frames the clock hand passed. */
+static size_t max_sweep;            /* Most frames passed in one eviction. */
 
+static void *get_frame (enum palloc_flags flag, void *upage, bool evict);
+static bool evict_frame (bool old_only);
+static struct fte *clock_sweep (bool old_only);
+static void pageout_daemon (void *aux);
+static bool frame_is_clean (struct fte *entry, struct spte *spte);
+static void queue_writeback (struct fte *entry, struct spte *spte);
+static void queue_swap_writeback (struct fte *entries[], size_t cnt);
+static int assign_slot (struct fte *entry, struct spte *spte, int swap_id);
+static struct writeback *writeback_create (void);
+static void writeback_add_page (struct writeback *wb, struct fte *entry);
+static void writeback_start (struct writeback *wb);
+static void writeback_work (struct work *work);
+static void free_frame (struct fte *entry);
+
+/* lab3 - sets up the frame table and starts the page-out daemon
+   with watermarks LOW and HIGH, in free frames.  Zero for either
+   picks a default from the size of the user pool. */
 void
-frame_table_init ()
+frame_table_init (size_t low, size_t high)
 {
-    list_init (&frame_table);
+    frame_cnt = palloc_user_page_cnt ();
+    frame_table = calloc (frame_cnt, sizeof *frame_table);
+    if (frame_table == NULL && frame_cnt > 0)
+        PANIC ("could not allocate frame table");
     lock_init (&frame_table_lock);
-    clock = NULL;
+    cond_init (&writeback_done);
+    clock = 0;
+    if (!workqueue_create (&writeback_wq, "writeback", 1, PRI_DEFAULT))
+        PANIC ("could not start writeback work queue");
+
+    low_wm = low != 0 ? low : frame_cnt / 32 + 1;
+    high_wm = high != 0 ? high : 2 * low_wm;
+    if (high_wm > frame_cnt / 2)
+        high_wm = frame_cnt / 2;
+    if (low_wm > high_wm)
+        low_wm = high_wm;
+    sema_init (&pageout_sema, 0);
+    pageout_awake = false;
+    if (thread_create ("pageout", PRI_DEFAULT, pageout_daemon, NULL)
+        == TID_ERROR)
+        PANIC ("could not start page-out daemon");
 }
 
 void *
 falloc_get_page (enum palloc_flags flag, void *upage)
+{
+    return get_frame (flag, upage, true);
+}
+
+/* lab3 - like falloc_get_page(), but returns NULL rather than
+   evict a frame or wake the page-out daemon, for pages that are
+   only read in because they might be needed soon. */
+void *
+falloc_get_free_page (enum palloc_flags flag, void *upage)
+{
+    return get_frame (flag, upage, false);
+}
+
+/* lab3 - allocates a frame for UPAGE of the current thread,
+   evicting one if there is none free and EVICT is true. */
+static void *
+get_frame (enum palloc_flags flag, void *upage, bool evict)
 {
     void *kpage;
     struct fte *entry;
+
+    ASSERT (flag & PAL_USER);
+
     lock_acquire (&frame_table_lock);
+    if (!evict && palloc_user_free_cnt () <= low_wm)
+    {
+        lock_release (&frame_table_lock);
+        return NULL;
+    }
     kpage = palloc_get_page (flag);
     if (kpage == NULL)
     {
-        evict_frame ();
+        if (!evict)
+        {
+            lock_release (&frame_table_lock);
+            return NULL;
+        }
+        if (evict_frame (false))
+            direct_evict_cnt++;
         kpage = palloc_get_page (flag);
         if (kpage == NULL)
+        {
+            lock_release (&frame_table_lock);
             return NULL;
+        }
     }
-    entry = (struct fte *) malloc (sizeof *entry);
+    entry = &frame_table[palloc_user_page_idx (kpage)];
     entry -> kpage = kpage;
     entry -> upage = upage;
     entry -> thread = thread_current ();
-    list_push_back (&frame_table, &(entry -> list_elem));
+    entry -> last_use = entry -> thread -> vm_ticks;
+    entry -> writeback = false;
+    entry -> pinned = true;
+    if (!pageout_awake && palloc_user_free_cnt () < low_wm)
+    {
+        pageout_awake = true;
+        pageout_wake_cnt++;
+        sema_up (&pageout_sema);
+    }
     lock_release (&frame_table_lock);
     return kpage;
 }
@@ -48,63 +202,448 @@ falloc_free_page (void *kpage)
     struct fte *entry = get_fte (kpage);
     if (entry == NULL)
         syscall_exit (-1);
-    list_remove (&(entry -> list_elem));
-    palloc_free_page (entry -> kpage);
-    pagedir_clear_page(entry -> thread -> pagedir, entry -> upage);
-    free (entry);
+    free_frame (entry);
     lock_release (&frame_table_lock);
 }
 
-struct fte *
-get_fte (void *kpage)
+/* lab3 - lets the frame at KPAGE, whose page is now mapped, be
+   evicted. */
+void
+falloc_unpin (void *kpage)
 {
-    struct list_elem *elem;
-    for (elem = list_begin (&frame_table); elem != list_end (&frame_table); elem = list_next(elem))
+    lock_acquire (&frame_table_lock);
+    struct fte *entry = get_fte (kpage);
+    ASSERT (entry != NULL && entry -> pinned);
+    entry -> pinned = false;
+    lock_release (&frame_table_lock);
+}
+
+/* lab3 - waits for any writeback of the current thread's page
+   UPAGE to finish, then pins its frame, so that munmap can write
+   the page to its file and free it knowing that it is not being
+   written or evicted meanwhile.  Returns the frame, or a null
+   pointer if the page is not in memory.  Must not be called with
+   file_lock held, which writeback takes. */
+void *
+falloc_hold_page (void *upage)
+{
+    struct thread *t = thread_current ();
+    void *kpage;
+
+    lock_acquire (&frame_table_lock);
+    for (;;)
     {
-        struct fte *entry = list_entry (elem, struct fte, list_elem);
-        if (entry -> kpage == kpage)
-            return entry;
+        lock_acquire (&t -> spt_lock);
+        struct spte *spte = get_spte (&(t -> spt), upage);
+        kpage = spte != NULL && spte -> type == SPAGE_FRAME ? spte -> kpage : NULL;
+        lock_release (&t -> spt_lock);
+        if (kpage == NULL)
+            break;
+
+        struct fte *entry = get_fte (kpage);
+        if (!entry -> writeback)
+        {
+            entry -> pinned = true;
+            break;
+        }
+        cond_wait (&writeback_done, &frame_table_lock);
     }
-    return NULL;
+    lock_release (&frame_table_lock);
+    return kpage;
 }
 
+/* lab3 - frees every frame that T owns, for process exit. */
 void
-evict_frame ()
+falloc_free_thread (struct thread *t)
 {
-    struct fte *entry;
-    struct thread *thread = thread_current ();
+    size_t i;
 
-    if (clock == NULL)
-        clock = list_begin (&frame_table);
+    lock_acquire (&frame_table_lock);
+    for (i = 0; i < frame_cnt; i++)
+        if (frame_table[i].thread == t)
+            free_frame (&frame_table[i]);
+    lock_release (&frame_table_lock);
+}
 
-    for (clock; clock != list_end (&frame_table); clock = list_next (clock))
+struct fte *
+get_fte (void *kpage)
+{
+    struct fte *entry = &frame_table[palloc_user_page_idx (kpage)];
+    return entry -> thread != NULL ? entry : NULL;
+}
+
+void
+frame_table_print_stats (void)
+{
+    printf ("Frame table: %zu frames, %lld evictions (%lld clean, "
+            "%lld by faulting threads), %lld writebacks "
+            "(%lld swap clusters), %lld frames swept (longest sweep %zu)\n",
+            frame_cnt, evict_cnt, clean_evict_cnt, direct_evict_cnt,
+            writeback_total, cluster_cnt, sweep_cnt, max_sweep);
+    printf ("Page-out daemon: watermarks %zu/%zu free frames, "
+            "woken %lld times\n", low_wm, high_wm, pageout_wake_cnt);
+}
+
+/* lab3 - the page-out daemon's thread.  Evicts one frame at a
+   time, so as not to hold the frame table lock for long, until
+   HIGH_WM frames are free or no more frames have left the working
+   set.  Younger frames, including those just read in, are left to
+   faulting threads that have no other choice. */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+    for (;;)
     {
-        entry = list_entry (clock, struct fte, list_elem);
+        sema_down (&pageout_sema);
 
-        if (pagedir_is_accessed (thread -> pagedir, entry -> upage))
-            pagedir_set_accessed (thread -> pagedir, entry -> upage, false);
+        for (;;)
+        {
+            lock_acquire (&frame_table_lock);
+            bool more = palloc_user_free_cnt () < high_wm && evict_frame (true);
+            if (!more)
+                pageout_awake = false;
+            lock_release (&frame_table_lock);
+            if (!more)
+                break;
+            thread_yield ();
+        }
+    }
+}
+
+/* lab3 - runs the WSClock hand until it finds a frame to evict,
+   and evicts it.  If OLD_ONLY is true, only an old clean frame
+   will do, and dirty ones are only queued for writeback.  Returns
+   false if there was no frame to evict.  Must be called with the
+   frame table lock held. */
+static bool
+evict_frame (bool old_only)
+{
+    struct fte *entry;
+
+    while ((entry = clock_sweep (old_only)) != NULL)
+    {
+        /* Unmap the page before looking at its dirty bit again, so
+           its owner cannot write to it any more, and hold the
+           owner's spt_lock until its spte says where the page went,
+           so a fault on it waits for that. */
+        struct thread *t = entry -> thread;
+        lock_acquire (&t -> spt_lock);
+        pagedir_clear_page (t -> pagedir, entry -> upage);
+        struct spte *spte = get_spte (&(t -> spt), entry -> upage);
+        if (spte == NULL)
+        {
+            /* Unmapped by munmap: nothing to keep. */
+            clean_evict_cnt++;
+        }
+        else if (frame_is_clean (entry, spte))
+        {
+            /* Its contents are safe elsewhere: just drop it. */
+            spte -> type = spte -> swap_id != -1 ? SPAGE_SWAP : SPAGE_FILE;
+            spte -> kpage = NULL;
+            clean_evict_cnt++;
+        }
+        else if (spte -> mmap)
+        {
+            /* Written to since the sweep.  Its place is in its file,
+               not in swap, and writing it there would mean taking
+               file_lock after the frame table lock, so give it back
+               and look again. */
+            pagedir_set_page (t -> pagedir, entry -> upage, entry -> kpage,
+                              spte -> writable);
+            pagedir_set_dirty (t -> pagedir, entry -> upage, true);
+            lock_release (&t -> spt_lock);
+            continue;
+        }
         else
-            break;
+        {
+            struct swap_page page = { entry -> kpage, t, entry -> upage };
+            if (spte -> swap_id == -1)
+                spte -> swap_id = swap_alloc (1);
+            swap_write_pages (spte -> swap_id, 1, &page);
+            spte -> type = SPAGE_SWAP;
+            spte -> kpage = NULL;
+        }
+        lock_release (&t -> spt_lock);
+
+        free_frame (entry);
+        evict_cnt++;
+        return true;
     }
+    return false;
+}
+
+/* lab3 - sweeps the WSClock hand for evict_frame(), queueing old
+   dirty frames for writeback on the way, and returns the frame to
+   evict, or NULL if there is none.  The last resort, an
+   unreferenced dirty frame, is only taken if it can go to swap:
+   a dirty frame mapped from a file must wait for its writeback. */
+static struct fte *
+clock_sweep (bool old_only)
+{
+    struct fte *entry = NULL, *young = NULL, *dirty = NULL;
+    struct fte *cluster[SWAP_CLUSTER];
+    size_t cluster_len = 0;
+    size_t sweep;
 
-    if (clock == list_end (&frame_table))
+    for (sweep = 0; sweep < 2 * frame_cnt && entry == NULL; sweep++)
     {
-        for (clock = list_begin (&frame_table); clock != list_end (&frame_table); clock = list_next (clock))
+        struct fte *e = &frame_table[clock];
+        clock = (clock + 1) % frame_cnt;
+
+        if (e -> thread == NULL || e -> writeback || e -> pinned)
+            continue;
+
+        struct thread *t = e -> thread;
+        if (pagedir_is_accessed (t -> pagedir, e -> upage))
         {
-            entry = list_entry (clock, struct fte, list_elem);
+            pagedir_set_accessed (t -> pagedir, e -> upage, false);
+            e -> last_use = t -> vm_ticks;
+            continue;
+        }
 
-            if (pagedir_is_accessed (thread -> pagedir, entry -> upage))
-                pagedir_set_accessed (thread -> pagedir, entry -> upage, false);
+        bool old = t -> vm_ticks - e -> last_use > WS_TAU;
+        lock_acquire (&t -> spt_lock);
+        struct spte *spte = get_spte (&(t -> spt), e -> upage);
+        if (frame_is_clean (e, spte))
+        {
+            if (old)
+                entry = e;
+            else if (young == NULL)
+                young = e;
+        }
+        else if (old && writeback_cnt + cluster_len < WRITEBACK_MAX)
+        {
+            if (spte -> mmap)
+                queue_writeback (e, spte);
             else
-                break;
+            {
+                /* Held back from the sweep until the cluster is
+                   written, so it is not gathered twice. */
+                e -> writeback = true;
+                cluster[cluster_len++] = e;
+            }
+        }
+        else if (dirty == NULL && !spte -> mmap)
+            dirty = e;
+        lock_release (&t -> spt_lock);
+
+        if (cluster_len == SWAP_CLUSTER)
+        {
+            queue_swap_writeback (cluster, cluster_len);
+            cluster_len = 0;
         }
     }
+    if (cluster_len > 0)
+        queue_swap_writeback (cluster, cluster_len);
 
-    struct spte *spte = get_spte (&(thread_current () -> spt), entry ->upage);
-    spte -> type = SPAGE_SWAP;
-    spte -> swap_id = swap_out (entry -> kpage);
+    sweep_cnt += sweep;
+    if (sweep > max_sweep)
+        max_sweep = sweep;
+
+    if (entry == NULL && !old_only)
+        entry = young;
+    if (entry == NULL && !old_only)
+        entry = dirty;
+    return entry;
+}
+
+/* lab3 - returns true if ENTRY, whose owner's page table entry is
+   SPTE, can be evicted without writing it anywhere: it has not
+   been written since it was last read in or written back, and
+   that copy is in a swap slot or in its file.  A frame whose spte
+   is gone, after munmap, holds nothing worth keeping. */
+static bool
+frame_is_clean (struct fte *entry, struct spte *spte)
+{
+    if (spte == NULL)
+        return true;
+    if (pagedir_is_dirty (entry -> thread -> pagedir, entry -> upage))
+        return false;
+    return spte -> swap_id != -1 || spte -> file != NULL;
+}
+
+/* lab3 - queues ENTRY, a dirty frame mapped from a file whose
+   owner's page table entry is SPTE, to be written to the file.
+   Must be called with the frame table lock held. */
+static void
+queue_writeback (struct fte *entry, struct spte *spte)
+{
+    struct writeback *wb = writeback_create ();
+    if (wb == NULL)
+        return;
+
+    wb -> file = spte -> file;
+    wb -> ofs = spte -> ofs;
+    wb -> bytes = spte -> read_bytes;
+    writeback_add_page (wb, entry);
+    writeback_start (wb);
+}
+
+/* lab3 - queues the CNT dirty ENTRIES, already marked as under
+   writeback, to be written to swap.  They are given a run of
+   neighbouring slots, freeing the slots they had, and written
+   with one request; if there is no such run, each is written to
+   a slot of its own.  Must be called with the frame table lock
+   held. */
+static void
+queue_swap_writeback (struct fte *entries[], size_t cnt)
+{
+    struct spte *sptes[SWAP_CLUSTER];
+    struct writeback *wb;
+    int swap_id = -1;
+    size_t i;
+
+    for (i = 0; i < cnt; i++)
+    {
+        struct thread *t = entries[i] -> thread;
+        lock_acquire (&t -> spt_lock);
+        sptes[i] = get_spte (&(t -> spt), entries[i] -> upage);
+        if (cnt > 1 && sptes[i] -> swap_id != -1)
+        {
+            swap_free (sptes[i] -> swap_id);
+            sptes[i] -> swap_id = -1;
+        }
+        lock_release (&t -> spt_lock);
+    }
+    if (cnt > 1)
+        swap_id = swap_alloc (cnt);
+
+    if (swap_id != -1)
+    {
+        wb = writeback_create ();
+        for (i = 0; i < cnt; i++)
+        {
+            if (wb == NULL)
+            {
+                swap_free (swap_id + i);
+                entries[i] -> writeback = false;
+                continue;
+            }
+            assign_slot (entries[i], sptes[i], swap_id + i);
+            writeback_add_page (wb, entries[i]);
+        }
+        if (wb != NULL)
+        {
+            wb -> swap_id = swap_id;
+            writeback_start (wb);
+            cluster_cnt++;
+        }
+        return;
+    }
+
+    for (i = 0; i < cnt; i++)
+    {
+        wb = writeback_create ();
+        if (wb == NULL)
+        {
+            entries[i] -> writeback = false;
+            continue;
+        }
+        wb -> swap_id = assign_slot (entries[i], sptes[i], -1);
+        writeback_add_page (wb, entries[i]);
+        writeback_start (wb);
+    }
+}
+
+/* lab3 - gives SPTE, the page table entry of ENTRY's page, swap
+   slot SWAP_ID, or if that is -1 keeps its slot, allocating one if
+   it has none, and returns the slot. */
+static int
+assign_slot (struct fte *entry, struct spte *spte, int swap_id)
+{
+    struct thread *t = entry -> thread;
+
+    lock_acquire (&t -> spt_lock);
+    if (swap_id != -1)
+        spte -> swap_id = swap_id;
+    else if (spte -> swap_id == -1)
+        spte -> swap_id = swap_alloc (1);
+    swap_id = spte -> swap_id;
+    lock_release (&t -> spt_lock);
+    return swap_id;
+}
+
+/* lab3 - returns a new, empty writeback, or NULL if memory is
+   short. */
+static struct writeback *
+writeback_create (void)
+{
+    struct writeback *wb = malloc (sizeof *wb);
+    if (wb != NULL)
+    {
+        wb -> file = NULL;
+        wb -> swap_id = -1;
+        wb -> cnt = 0;
+    }
+    return wb;
+}
+
+/* lab3 - adds ENTRY's frame to WB. */
+static void
+writeback_add_page (struct writeback *wb, struct fte *entry)
+{
+    struct swap_page *page = &wb -> pages[wb -> cnt];
+
+    ASSERT (wb -> cnt < SWAP_CLUSTER);
+    page -> kpage = entry -> kpage;
+    page -> thread = entry -> thread;
+    page -> upage = entry -> upage;
+    wb -> entries[wb -> cnt++] = entry;
+}
+
+/* lab3 - clears the dirty bits of WB's frames, so that a write
+   during writeback makes a frame dirty again, and queues WB.
+   Must be called with the frame table lock held. */
+static void
+writeback_start (struct writeback *wb)
+{
+    for (size_t i = 0; i < wb -> cnt; i++)
+    {
+        struct fte *entry = wb -> entries[i];
+        pagedir_set_dirty (entry -> thread -> pagedir, entry -> upage, false);
+        entry -> writeback = true;
+    }
+    writeback_cnt += wb -> cnt;
+    writeback_total += wb -> cnt;
+    work_init (&wb -> work, writeback_work, wb);
+    queue_work (&writeback_wq, &wb -> work);
+}
+
+/* lab3 - writes back the frames of a writeback, for
+   queue_writeback() and queue_swap_writeback(). */
+static void
+writeback_work (struct work *work)
+{
+    struct writeback *wb = work -> aux;
+    size_t i;
+
+    if (wb -> file != NULL)
+    {
+        rwlock_acquire_write (&file_lock);
+        file_write_at (wb -> file, wb -> entries[0] -> kpage, wb -> bytes, wb -> ofs);
+        rwlock_release_write (&file_lock);
+    }
+    else
+        swap_write_pages (wb -> swap_id, wb -> cnt, wb -> pages);
 
-    lock_release (&frame_table_lock);
-    falloc_free_page (entry -> kpage);
     lock_acquire (&frame_table_lock);
-}
\ No newline at end of file
+    for (i = 0; i < wb -> cnt; i++)
+        wb -> entries[i] -> writeback = false;
+    writeback_cnt -= wb -> cnt;
+    cond_broadcast (&writeback_done, &frame_table_lock);
+    lock_release (&frame_table_lock);
+    free (wb);
+}
+
+/* lab3 - frees ENTRY's frame and unmaps it from its owner, once
+   any writeback of it is done.  Must be called with the frame
+   table lock held. */
+static void
+free_frame (struct fte *entry)
+{
+    while (entry -> writeback)
+        cond_wait (&writeback_done, &frame_table_lock);
+    pagedir_clear_page (entry -> thread -> pagedir, entry -> upage);
+    palloc_free_page (entry -> kpage);
+    entry -> thread = NULL;
+}
@@ -3,8 +3,7 @@
 #ifndef VM_FALLOC_H
 #define VM_FALLOC_H
 
-#include <list.h>
-
+#include "threads/palloc.h"
 #include "threads/thread.h"
 
 // fte: frame table entry
@@ -13,13 +12,20 @@ struct fte
     void *kpage;
     void *upage;
 
-    struct thread *thread;
-    struct list_elem list_elem;
+    struct thread *thread;      /* Owner, or NULL if the frame is free. */
+    int64_t last_use;           /* Owner's vm_ticks when last referenced. */
+    bool writeback;             /* Being written back? */
+    bool pinned;                /* Being read in: not to be evicted. */
 };
 
-void frame_table_init (void);
+void frame_table_init (size_t low_wm, size_t high_wm);
 void *falloc_get_page (enum palloc_flags flag, void *upage);
+void *falloc_get_free_page (enum palloc_flags flag, void *upage);
 void falloc_free_page (void *kpage);
+void falloc_unpin (void *kpage);
+void *falloc_hold_page (void *upage);
+void falloc_free_thread (struct thread *t);
 struct fte *get_fte (void *kpage);
+void frame_table_print_stats (void);
 
-#endif
\ No newline at end of file
+#endif
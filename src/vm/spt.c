@@ -1,11 +1,14 @@
 /* lab3 - supplemental page table */
 #include <hash.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "filesys/file.h"
 #include "filesys/off_t.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "vm/falloc.h"
 #include "vm/spt.h"
@@ -15,7 +18,58 @@ unsigned spt_hash_func (struct hash_elem *hash_elem, void *aux);
 bool spt_less_func (const struct hash_elem *e1, const struct hash_elem *e2, void *aux);
 void spt_destroy_func (struct hash_elem *elem, void *aux);
 
-extern struct lock file_lock;
+extern struct rwlock file_lock;
+
+static struct kmem_cache *spte_cache;
+
+/* lab3 - page faults served by load_page(): major ones had to
+   read the page from swap or a file, minor ones did not. */
+static long long swap_fault_cnt;
+static long long file_fault_cnt;
+static long long minor_fault_cnt;
+static long long swap_cluster_cnt;  /* Pages read in with a neighbour. */
+
+/* lab3 - fault-around.  After serving a fault, load_page() also
+   maps up to the thread's AHEAD_WINDOW pages that follow the
+   faulting page, reading them from swap or from their file if need
+   be, so that a process going through its pages in order takes one
+   fault for several of them.  The window doubles, up to AHEAD_MAX,
+   whenever a fault lands just past the pages mapped ahead last
+   time and some of them were used, and halves whenever a fault
+   lands anywhere else.  Pages are only mapped ahead into free
+   frames, never by evicting others. */
+#define AHEAD_MAX 16
+
+static long long ahead_cnt;         /* Pages mapped ahead. */
+static long long avoided_cnt;       /* Of those, pages then used. */
+
+/* lab3 - pages being read from neighbouring swap slots with one
+   request. */
+struct swap_run
+{
+    int first;                      /* Slot of the first page. */
+    size_t cnt;
+    struct spte *sptes[SWAP_CLUSTER];
+    void *kpages[SWAP_CLUSTER];
+};
+
+static bool load_file (struct spte *entry, void *kpage);
+static void swap_in_cluster (struct hash *spt, struct spte *entry, void *kpage);
+static bool swap_neighbour (struct hash *spt, int swap_id, struct spte **spte,
+                            void **kpage);
+static void swap_run_finish (struct swap_run *run, struct spte *skip);
+static size_t ahead_used (struct thread *t);
+static void ahead_adapt (struct thread *t, void *upage);
+static void fault_ahead (struct hash *spt, void *upage);
+static bool map_ahead (struct spte *entry, struct swap_run *run);
+
+void
+init_spte_cache (void)
+{
+    spte_cache = kmem_cache_create ("spte", sizeof (struct spte), NULL);
+    if (spte_cache == NULL)
+        PANIC ("could not create spte cache");
+}
 
 void
 init_spt (struct hash *spt)
@@ -51,19 +105,28 @@ void
 spt_destroy_func (struct hash_elem *elem, void *aux)
 {
     struct spte *entry = hash_entry (elem, struct spte, hash_elem);
-    free(entry);
+    if (entry -> swap_id != -1)
+        swap_free (entry -> swap_id);
+    kmem_cache_free (spte_cache, entry);
 }
 
 struct spte *
 spalloc (struct hash *spt, void *upage, void *kpage, enum spage_type type)
 {
-    struct spte *entry = (struct spte *)malloc (sizeof *entry);
+    struct thread *t = thread_current ();
+    struct spte *entry = kmem_cache_alloc (spte_cache);
+
+    ASSERT (spt == &(t -> spt));
     entry -> type = type;
     entry -> upage = upage;
     entry -> kpage = kpage;
     entry -> file = NULL;
     entry -> writable = true;
+    entry -> mmap = false;
+    entry -> swap_id = -1;
+    lock_acquire (&(t -> spt_lock));
     hash_insert (spt, &(entry -> hash_elem));
+    lock_release (&(t -> spt_lock));
     return entry;
 }
 
@@ -79,7 +142,7 @@ spalloc_frame (struct hash *spt, void *upage, void *kpage)
     struct spte *entry = spalloc(spt, upage, kpage, SPAGE_FRAME);
 }
 
-void
+struct spte *
 spalloc_file (struct hash *spt, void *upage, struct file *file, off_t ofs, uint32_t read_bytes, uint32_t zero_bytes, bool writable)
 {
     struct spte *entry = spalloc(spt, upage, NULL, SPAGE_FILE);
@@ -88,62 +151,101 @@ spalloc_file (struct hash *spt, void *upage, struct file *file, off_t ofs, uint3
     entry -> read_bytes = read_bytes;
     entry -> zero_bytes = zero_bytes;
     entry -> writable = writable;
+    return entry;
 }
 
 bool
 load_page (struct hash *spt, void *upage)
 {
+    struct thread *t = thread_current ();
+
+    /* Waits for an eviction of the page to finish.  The evictor
+       leaves sptes of pages that are not in memory alone, so the
+       rest of ENTRY can be read without the lock. */
+    lock_acquire (&(t -> spt_lock));
     struct spte *entry = get_spte (spt, upage);
+    enum spage_type type = entry != NULL ? entry -> type : SPAGE_ZERO;
+    lock_release (&(t -> spt_lock));
     if (entry == NULL)
         syscall_exit (-1);
 
-    void *kpage = falloc_get_page (PAL_USER, upage);
+    ahead_adapt (t, upage);
+
+    /* Zero pages come pre-zeroed from palloc when it can.  The
+       frame stays pinned until the page is mapped. */
+    void *kpage = falloc_get_page (type == SPAGE_ZERO
+                                   ? PAL_USER | PAL_ZERO : PAL_USER, upage);
     if (kpage == NULL)
         syscall_exit (-1);
-    
-    bool flag = lock_held_by_current_thread (&file_lock);
 
-    switch (entry -> type)
+    switch (type)
     {
         case SPAGE_ZERO:
-            memset (kpage, 0, PGSIZE);
+            minor_fault_cnt++;
             break;
         case SPAGE_FRAME:
+            minor_fault_cnt++;
             break;
         case SPAGE_SWAP:
-            swap_in (entry, kpage);
+            /* Reading it in frees the slot, so the page only exists
+               in memory now and must be written out again to evict
+               it. */
+            swap_in_cluster (spt, entry, kpage);
+            entry -> swap_id = -1;
+            swap_fault_cnt++;
             break;
         case SPAGE_FILE:
-            if (!flag)
-                lock_acquire (&file_lock);
-            if (file_read_at (entry -> file, kpage, entry -> read_bytes, entry -> ofs) != entry -> read_bytes)
+            file_fault_cnt++;
+            if (!load_file (entry, kpage))
             {
                 falloc_free_page (kpage);
-                lock_release (&file_lock);
                 syscall_exit (-1);
             }
-
-            memset (kpage + (entry -> read_bytes), 0, entry -> zero_bytes);
-            if(!flag)
-                lock_release (&file_lock);
             break;
         default:
             syscall_exit (-1);
     }
 
-    uint32_t *pagedir = thread_current () -> pagedir;
+    uint32_t *pagedir = t -> pagedir;
+    lock_acquire (&(t -> spt_lock));
     if (!pagedir_set_page (pagedir, upage, kpage, entry -> writable))
     {
+        lock_release (&(t -> spt_lock));
         falloc_free_page (kpage);
         syscall_exit (-1);
     }
 
+    if (type == SPAGE_SWAP)
+        pagedir_set_dirty (pagedir, upage, true);
+
     entry -> kpage = kpage;
     entry -> type = SPAGE_FRAME;
+    lock_release (&(t -> spt_lock));
+    falloc_unpin (kpage);
 
+    fault_ahead (spt, upage);
     return true;
 }
 
+/* lab3 - reads ENTRY's page from its file into KPAGE, zeroing the
+   rest of the page.  Returns false if the file is too short. */
+static bool
+load_file (struct spte *entry, void *kpage)
+{
+    bool flag = rwlock_held_by_current_thread (&file_lock);
+    bool success;
+
+    if (!flag)
+        rwlock_acquire_read (&file_lock);
+    success = file_read_at (entry -> file, kpage, entry -> read_bytes, entry -> ofs) == entry -> read_bytes;
+    if (!flag)
+        rwlock_release_read (&file_lock);
+
+    if (success)
+        memset (kpage + (entry -> read_bytes), 0, entry -> zero_bytes);
+    return success;
+}
+
 struct spte *
 get_spte (struct hash *spt, void *upage)
 {
@@ -158,8 +260,277 @@ get_spte (struct hash *spt, void *upage)
         return hash_entry (elem, struct spte, hash_elem);
 }
 
+/* lab3 - reads ENTRY's page from swap into KPAGE, together with
+   the pages in the slots around it, up to SWAP_CLUSTER in all, as
+   long as they are this process's pages still waiting in swap and
+   there are free frames for them.  Pages evicted together were
+   given neighbouring slots, so they are likely to be needed
+   together again.  The neighbours are mapped as well. */
+static void
+swap_in_cluster (struct hash *spt, struct spte *entry, void *kpage)
+{
+    struct swap_run run;
+
+    if (swap_slot_upage (entry -> swap_id, thread_current ()) != entry -> upage)
+        syscall_exit (-1);
+
+    run.first = entry -> swap_id;
+    run.cnt = 1;
+    run.sptes[0] = entry;
+    run.kpages[0] = kpage;
+    while (run.cnt < SWAP_CLUSTER
+           && swap_neighbour (spt, run.first + run.cnt,
+                              &run.sptes[run.cnt], &run.kpages[run.cnt]))
+        run.cnt++;
+    while (run.cnt < SWAP_CLUSTER && run.first > 0)
+    {
+        struct spte *e;
+        void *k;
+
+        if (!swap_neighbour (spt, run.first - 1, &e, &k))
+            break;
+        memmove (run.sptes + 1, run.sptes, run.cnt * sizeof *run.sptes);
+        memmove (run.kpages + 1, run.kpages, run.cnt * sizeof *run.kpages);
+        run.sptes[0] = e;
+        run.kpages[0] = k;
+        run.first--;
+        run.cnt++;
+    }
+
+    swap_cluster_cnt += run.cnt - 1;
+    swap_run_finish (&run, entry);
+}
+
+/* lab3 - if slot SWAP_ID holds a page of this process that is
+   waiting in swap, and a frame is free for it, stores the page's
+   spte in *SPTE and the frame in *KPAGE and returns true. */
+static bool
+swap_neighbour (struct hash *spt, int swap_id, struct spte **spte, void **kpage)
+{
+    void *upage = swap_slot_upage (swap_id, thread_current ());
+    if (upage == NULL)
+        return false;
+
+    struct spte *e = get_spte (spt, upage);
+    if (e == NULL || e -> type != SPAGE_SWAP || e -> swap_id != swap_id)
+        return false;
+
+    *kpage = falloc_get_free_page (PAL_USER, upage);
+    if (*kpage == NULL)
+        return false;
+    *spte = e;
+    return true;
+}
+
+/* lab3 - reads RUN's pages from swap, which frees their slots,
+   and maps and unpins all of them but SKIP, whose fault is being
+   served.  Their frames stay pinned until then, since nothing
+   else shows that they are in use. */
+static void
+swap_run_finish (struct swap_run *run, struct spte *skip)
+{
+    struct thread *t = thread_current ();
+    uint32_t *pagedir = t -> pagedir;
+    size_t i;
+
+    if (run -> cnt == 0)
+        return;
+    swap_in_pages (run -> first, run -> cnt, run -> kpages);
+
+    for (i = 0; i < run -> cnt; i++)
+    {
+        struct spte *e = run -> sptes[i];
+
+        if (e == skip)
+            continue;
+        /* The slot is free now, so the page is lost if it cannot
+           be mapped. */
+        lock_acquire (&(t -> spt_lock));
+        if (!pagedir_set_page (pagedir, e -> upage, run -> kpages[i], e -> writable))
+        {
+            lock_release (&(t -> spt_lock));
+            falloc_free_page (run -> kpages[i]);
+            syscall_exit (-1);
+        }
+        pagedir_set_dirty (pagedir, e -> upage, true);
+        e -> kpage = run -> kpages[i];
+        e -> type = SPAGE_FRAME;
+        e -> swap_id = -1;
+        lock_release (&(t -> spt_lock));
+        falloc_unpin (run -> kpages[i]);
+    }
+    run -> cnt = 0;
+}
+
+/* lab3 - counts the pages T mapped ahead at its last fault that
+   have been used since, by their accessed bits, as faults
+   avoided, and forgets them.  Returns the count.  The clock hand
+   clears accessed bits too, so this may undercount. */
+static size_t
+ahead_used (struct thread *t)
+{
+    size_t used = 0, i;
+
+    for (i = 0; i < AHEAD_MAX; i++)
+        if ((t -> ahead_mask & (1u << i))
+            && pagedir_is_accessed (t -> pagedir, t -> ahead_start + i * PGSIZE))
+            used++;
+    t -> ahead_mask = 0;
+    t -> faults_avoided += used;
+    avoided_cnt += used;
+    return used;
+}
+
+/* lab3 - sizes T's fault-around window for a fault on UPAGE:
+   grows it if the fault continues a sequential run whose pages
+   mapped ahead were used, shrinks it otherwise. */
+static void
+ahead_adapt (struct thread *t, void *upage)
+{
+    bool mapped = t -> ahead_mask != 0;
+    size_t used = ahead_used (t);
+
+    if (upage == t -> fault_next && (!mapped || used > 0))
+    {
+        t -> ahead_window = t -> ahead_window == 0 ? 1 : 2 * t -> ahead_window;
+        if (t -> ahead_window > AHEAD_MAX)
+            t -> ahead_window = AHEAD_MAX;
+    }
+    else
+        t -> ahead_window /= 2;
+}
+
+/* lab3 - maps the pages in the current thread's fault-around
+   window after UPAGE, stopping at the first one that cannot be,
+   and notes where a sequential run would fault next.  Pages that
+   are already mapped are passed over. */
+static void
+fault_ahead (struct hash *spt, void *upage)
+{
+    struct thread *t = thread_current ();
+    struct swap_run run;
+    size_t i;
+
+    run.cnt = 0;
+    t -> ahead_start = upage + PGSIZE;
+    for (i = 0; i < t -> ahead_window; i++)
+    {
+        void *page = upage + (i + 1) * PGSIZE;
+
+        if (!is_user_vaddr (page))
+            break;
+        if (pagedir_get_page (t -> pagedir, page) != NULL)
+            continue;
+
+        struct spte *e = get_spte (spt, page);
+        if (e == NULL || !map_ahead (e, &run))
+            break;
+        t -> ahead_mask |= 1u << i;
+        ahead_cnt++;
+    }
+    swap_run_finish (&run, NULL);
+    t -> fault_next = upage + (i + 1) * PGSIZE;
+}
+
+/* lab3 - maps ENTRY's page ahead of a fault, if it is not in
+   memory and a frame is free for it.  Zero pages are mapped to a
+   zeroed frame and file pages are read in; their frames are pinned
+   until they are mapped.  A page in swap is added to RUN, which is read and mapped
+   once no more neighbouring slots follow.  Returns false if the
+   page could not be mapped. */
+static bool
+map_ahead (struct spte *entry, struct swap_run *run)
+{
+    struct thread *t = thread_current ();
+    uint32_t *pagedir = t -> pagedir;
+    void *kpage;
+
+    /* Only the evictor changes a resident page's spte, and only we
+       make a page resident. */
+    lock_acquire (&(t -> spt_lock));
+    bool resident = entry -> type == SPAGE_FRAME;
+    lock_release (&(t -> spt_lock));
+    if (resident)
+        return false;
+
+    kpage = falloc_get_free_page (entry -> type == SPAGE_ZERO
+                                  ? PAL_USER | PAL_ZERO : PAL_USER, entry -> upage);
+    if (kpage == NULL)
+        return false;
+
+    switch (entry -> type)
+    {
+        case SPAGE_ZERO:
+            break;
+        case SPAGE_FILE:
+            if (!load_file (entry, kpage))
+            {
+                falloc_free_page (kpage);
+                return false;
+            }
+            break;
+        case SPAGE_SWAP:
+            if (swap_slot_upage (entry -> swap_id, thread_current ()) != entry -> upage)
+            {
+                falloc_free_page (kpage);
+                return false;
+            }
+            if (run -> cnt > 0 && (run -> cnt == SWAP_CLUSTER
+                                   || entry -> swap_id != run -> first + (int) run -> cnt))
+                swap_run_finish (run, NULL);
+            if (run -> cnt == 0)
+                run -> first = entry -> swap_id;
+            run -> sptes[run -> cnt] = entry;
+            run -> kpages[run -> cnt++] = kpage;
+            return true;
+        default:
+            falloc_free_page (kpage);
+            return false;
+    }
+
+    lock_acquire (&(t -> spt_lock));
+    if (!pagedir_set_page (pagedir, entry -> upage, kpage, entry -> writable))
+    {
+        lock_release (&(t -> spt_lock));
+        falloc_free_page (kpage);
+        return false;
+    }
+    entry -> kpage = kpage;
+    entry -> type = SPAGE_FRAME;
+    lock_release (&(t -> spt_lock));
+    falloc_unpin (kpage);
+    return true;
+}
+
+/* lab3 - counts the pages the current process mapped ahead at its
+   last fault and has used since, before its frames are freed at
+   exit. */
+void
+spt_fault_ahead_done (void)
+{
+    ahead_used (thread_current ());
+}
+
+void
+spt_print_stats (void)
+{
+    printf ("Page faults: %lld major (%lld from swap, %lld from files), "
+            "%lld minor; %lld pages swapped in with a neighbour\n",
+            swap_fault_cnt + file_fault_cnt, swap_fault_cnt,
+            file_fault_cnt, minor_fault_cnt, swap_cluster_cnt);
+    printf ("Fault-around: %lld pages mapped ahead, %lld faults avoided\n",
+            ahead_cnt, avoided_cnt);
+}
+
 void spdealloc (struct hash *spt, struct spte *entry)
 {
+    struct thread *t = thread_current ();
+
+    ASSERT (spt == &(t -> spt));
+    lock_acquire (&(t -> spt_lock));
     hash_delete (spt, &(entry -> hash_elem));
-    free (entry);
+    lock_release (&(t -> spt_lock));
+    if (entry -> swap_id != -1)
+        swap_free (entry -> swap_id);
+    kmem_cache_free (spte_cache, entry);
 }
\ No newline at end of file
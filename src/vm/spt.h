@@ -26,21 +26,25 @@ struct spte
     uint32_t read_bytes;
     uint32_t zero_bytes;
     bool writable;
+    bool mmap;                  /* Write back to FILE, not to swap. */
 
-    int swap_id;
+    int swap_id;                /* Swap slot holding a copy, or -1. */
 };
 
 void init_spt (struct hash *spt);
 void destroy_spt (struct hash *spt);
 
+void init_spte_cache (void);
 struct spte *spalloc (struct hash *spt, void *upage, void *kpage, enum spage_type type);
 void spalloc_zero (struct hash *spt, void *upage);
 void spalloc_frame (struct hash *pst, void *upage, void *kpage);
-void spalloc_file (struct hash *spt, void *upage, struct file *file, off_t ofs, uint32_t read_bytes, uint32_t zero_bytes, bool writable);
+struct spte *spalloc_file (struct hash *spt, void *upage, struct file *file, off_t ofs, uint32_t read_bytes, uint32_t zero_bytes, bool writable);
 void spdealloc (struct hash *spt, struct spte *entry);
 
 bool load_page (struct hash *spt, void *upage);
 struct spte *get_spte (struct hash *spt, void *upage);
+void spt_fault_ahead_done (void);
+void spt_print_stats (void);
 
 void spdealloc (struct hash *spt, struct spte *entry);
 
@@ -1,18 +1,33 @@
 /* lab3 - swap table */
 #include <bitmap.h>
+#include <stdio.h>
 
 #include "devices/block.h"
-#include "threads/vaddr.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
-#include "userprog/syscall.h"
-#include "vm/spt.h"
+#include "threads/vaddr.h"
 #include "vm/swap.h"
 
 #define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
 
+/* lab3 - whose page a swap slot holds.  Pages written out
+   together get neighbouring slots, so a process's pages that were
+   evicted together can be found, and read back together, by
+   looking at the slots next to one of them. */
+struct swap_slot
+{
+    struct thread *thread;
+    void *upage;
+};
+
 struct lock swap_lock;
 struct block *swap;
 struct bitmap *swap_table;
+static struct swap_slot *swap_slots;
+
+/* lab3 - swap I/O statistics */
+static long long pages_written, write_cnt;
+static long long pages_read, read_cnt;
 
 void
 init_swap ()
@@ -20,38 +35,102 @@ init_swap ()
     swap = block_get_role (BLOCK_SWAP);
     swap_table = bitmap_create(block_size(swap) / SECTORS_PER_PAGE);
     bitmap_set_all (swap_table, true);
+    swap_slots = calloc (bitmap_size (swap_table), sizeof *swap_slots);
+    if (swap_slots == NULL && bitmap_size (swap_table) > 0)
+        PANIC ("could not allocate swap slot table");
     lock_init (&swap_lock);
 }
 
+/* lab3 - reserves CNT neighbouring swap slots and returns the id
+   of the first, so that pages can be written to them later,
+   possibly more than once.  Returns -1 if there is no such run
+   of free slots; panics if there is no free slot at all. */
+int
+swap_alloc (size_t cnt)
+{
+    lock_acquire (&swap_lock);
+    
+    int swap_id = bitmap_scan_and_flip (swap_table, 0, cnt, true);
+    
+    lock_release (&swap_lock);
+
+    if (swap_id < 0 && cnt == 1)
+        PANIC ("out of swap slots");
+    return swap_id;
+}
+
+/* lab3 - writes the CNT PAGES to the reserved slots starting at
+   SWAP_ID, as one request to the swap device, and records whose
+   they are. */
 void
-swap_in (struct spte *entry, void *kvaddr)
+swap_write_pages (int swap_id, size_t cnt, const struct swap_page pages[])
 {
-    int swap_id = entry -> swap_id;
+    void *sectors[SWAP_CLUSTER * SECTORS_PER_PAGE];
 
-    lock_acquire (&swap_lock);
+    ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
 
-    if (swap_id > bitmap_size(swap_table) || swap_id < 0 || bitmap_test(swap_table, swap_id))
-        syscall_exit (-1);
-    
-    bitmap_set (swap_table, swap_id, true);
+    for (size_t i = 0; i < cnt; i++)
+    {
+        swap_slots[swap_id + i].thread = pages[i].thread;
+        swap_slots[swap_id + i].upage = pages[i].upage;
+        for (int j = 0; j < SECTORS_PER_PAGE; j++)
+            sectors[i * SECTORS_PER_PAGE + j] = pages[i].kpage + BLOCK_SECTOR_SIZE * j;
+    }
+    block_write_multiple (swap, swap_id * SECTORS_PER_PAGE, cnt * SECTORS_PER_PAGE, sectors);
+    pages_written += cnt;
+    write_cnt++;
+}
 
-    lock_release (&swap_lock);
+/* lab3 - reads the CNT slots starting at SWAP_ID into KPAGES, as
+   one request to the swap device, and frees the slots. */
+void
+swap_in_pages (int swap_id, size_t cnt, void *const kpages[])
+{
+    void *sectors[SWAP_CLUSTER * SECTORS_PER_PAGE];
 
-    for (int i = 0; i < SECTORS_PER_PAGE; i++)
-        block_read (swap, swap_id * SECTORS_PER_PAGE + i, kvaddr + BLOCK_SECTOR_SIZE * i);
+    ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+
+    for (size_t i = 0; i < cnt; i++)
+        for (int j = 0; j < SECTORS_PER_PAGE; j++)
+            sectors[i * SECTORS_PER_PAGE + j] = kpages[i] + BLOCK_SECTOR_SIZE * j;
+    block_read_multiple (swap, swap_id * SECTORS_PER_PAGE, cnt * SECTORS_PER_PAGE, sectors);
+    pages_read += cnt;
+    read_cnt++;
+
+    for (size_t i = 0; i < cnt; i++)
+        swap_free (swap_id + i);
 }
 
-int
-swap_out (void *kvaddr)
+/* lab3 - returns the user page that slot SWAP_ID holds for
+   thread T, or NULL if it holds nothing of T's. */
+void *
+swap_slot_upage (int swap_id, struct thread *t)
 {
+    void *upage = NULL;
+
+    if (swap_id < 0 || (size_t) swap_id >= bitmap_size (swap_table))
+        return NULL;
     lock_acquire (&swap_lock);
-    
-    int swap_id = bitmap_scan_and_flip (swap_table, 0, 1, true);
-    
+    if (!bitmap_test (swap_table, swap_id) && swap_slots[swap_id].thread == t)
+        upage = swap_slots[swap_id].upage;
     lock_release (&swap_lock);
-    
-    for (int i = 0; i < SECTORS_PER_PAGE; i++)
-        block_write (swap, swap_id * SECTORS_PER_PAGE + i, kvaddr + BLOCK_SECTOR_SIZE * i);
-    
-    return swap_id;
-}
\ No newline at end of file
+    return upage;
+}
+
+/* lab3 - releases slot SWAP_ID without reading it back. */
+void
+swap_free (int swap_id)
+{
+    lock_acquire (&swap_lock);
+    swap_slots[swap_id].thread = NULL;
+    bitmap_set (swap_table, swap_id, true);
+    lock_release (&swap_lock);
+}
+
+void
+swap_print_stats (void)
+{
+    printf ("Swap: %lld pages written in %lld requests, "
+            "%lld pages read in %lld requests\n",
+            pages_written, write_cnt, pages_read, read_cnt);
+}
@@ -2,8 +2,27 @@
 #ifndef VM_SWAP_H
 #define VM_SWAP_H
 
+#include <stddef.h>
+
+struct thread;
+
+/* lab3 - most pages written or read back as one cluster */
+#define SWAP_CLUSTER 8
+
+/* lab3 - a page to write to swap, and whose it is */
+struct swap_page
+{
+    void *kpage;
+    struct thread *thread;
+    void *upage;
+};
+
 void init_swap ();
-void swap_in (struct spte *entry, void *kvaddr);
-int swap_out (void *kvaddr);
+int swap_alloc (size_t cnt);
+void swap_write_pages (int swap_id, size_t cnt, const struct swap_page pages[]);
+void swap_in_pages (int swap_id, size_t cnt, void *const kpages[]);
+void *swap_slot_upage (int swap_id, struct thread *t);
+void swap_free (int swap_id);
+void swap_print_stats (void);
 
-#endif
\ No newline at end of file
+#endif